@@ -120,9 +120,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple (block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +131,42 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  block_write_multiple (block, sector, 1, buffer);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  The driver transfers them as a single request where it
+   can, which is much cheaper than CNT calls to block_read().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  block->ops->read (block->aux, sector, cnt, buffer);
+  block->read_cnt += cnt;
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes,
+   as a single request where the driver can.  Returns after the
+   block device has acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  ASSERT (cnt > 0);
   check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
   ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  block->ops->write (block->aux, sector, cnt, buffer);
+  block->write_cnt += cnt;
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -37,6 +37,7 @@ struct intq
 void intq_init (struct intq *);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
+int intq_room (const struct intq *);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
 
@@ -4,9 +4,11 @@
 #include <stdio.h>
 #include <string.h>
 #include "devices/input.h"
+#include "devices/intq.h"
 #include "devices/shutdown.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/workqueue.h"
 
 /* Keyboard data register port. */
 #define DATA_REG 0x60
@@ -24,12 +26,21 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes read by the interrupt handler, waiting to be
+   interpreted by kbd_work in a worker thread of system_wq. */
+static struct intq scancodes;
+static struct work kbd_work;
+
 static intr_handler_func keyboard_interrupt;
+static work_func interpret_scancodes;
+static void interpret_scancode (unsigned code);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
+  intq_init (&scancodes);
+  work_init (&kbd_work, interpret_scancodes);
   intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -92,28 +103,75 @@ static const struct keymap shifted_keymap[] =
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Reads the scancode the keyboard has ready and leaves the rest
+   to interpret_scancodes(), so that the handler runs with
+   interrupts off only briefly.  Scancodes that arrive while the
+   buffer is full are dropped, a prefixed scancode together with
+   its prefix, so that a lone prefix never turns the next key
+   into an extended one. */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  uint8_t code = inb (DATA_REG);
+  uint8_t second = 0;
+  int size = 1;
+
+  /* Read second byte if prefix code. */
+  if (code == 0xe0)
+    {
+      second = inb (DATA_REG);
+      size = 2;
+    }
+
+  if (intq_room (&scancodes) >= size)
+    {
+      intq_putc (&scancodes, code);
+      if (size == 2)
+        intq_putc (&scancodes, second);
+      work_queue (&system_wq, &kbd_work);
+    }
+}
+
+/* Work function that interprets the scancodes the interrupt
+   handler has buffered. */
+static void
+interpret_scancodes (struct work *w UNUSED) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (!intq_empty (&scancodes))
+    {
+      /* Get scancode, including second byte if prefix code. */
+      unsigned code = intq_getc (&scancodes);
+      if (code == 0xe0 && !intq_empty (&scancodes))
+        code = (code << 8) | intq_getc (&scancodes);
+
+      interpret_scancode (code);
+
+      /* Let interrupts in between keys. */
+      intr_set_level (old_level);
+      old_level = intr_disable ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Updates the shift key state for scancode CODE, or appends the
+   character it stands for to the input buffer.  Interrupts must
+   be off. */
+static void
+interpret_scancode (unsigned code) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
-
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
   release = (code & 0x80) != 0;
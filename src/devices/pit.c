@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,49 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Arms the given CHANNEL in mode 0, "interrupt on terminal
+   count": the channel's output goes to 1 once COUNT PIT cycles
+   have elapsed and then stays there, so channel 0 raises exactly
+   one timer interrupt.  COUNT must be between 1 and
+   PIT_MAX_COUNT.  Use pit_configure_channel() to go back to a
+   periodic mode. */
+void
+pit_configure_oneshot (int channel, uint32_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count >= 1 && count <= PIT_MAX_COUNT);
+
+  /* A count of 0 is treated as 65536 by the PIT. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/* Returns the current value of CHANNEL's down-counter and, if
+   OUTPUT is non-null, stores the state of its output line in
+   *OUTPUT.  Uses the 8254 read-back command, which latches the
+   status and count together so that they are consistent. */
+uint16_t
+pit_read_counter (int channel, bool *output)
+{
+  enum intr_level old_level;
+  uint8_t status, low, high;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (2 << channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  low = inb (PIT_PORT_COUNTER (channel));
+  high = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (output != NULL)
+    *output = (status & 0x80) != 0;
+  return low | (high << 8);
+}
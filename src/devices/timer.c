@@ -23,7 +23,49 @@ static int64_t ticks;
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
-struct list sleeping_threads;
+
+/* Sleeping threads, kept in a hierarchical timing wheel keyed on
+   wakeUpTime.  Level 0 has one slot per tick for the next
+   WHEEL0_SIZE ticks.  Each higher level has WHEELN_SIZE slots,
+   each covering one full turn of the level below it.  Inserting a
+   sleeper is O(1).  Whenever a level wraps around, the next slot of
+   the level above is cascaded down one level, so a sleeper is moved
+   at most once per level and expiry is amortized O(1) per tick. */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL_LEVELS 5                  /* 8 + 4 * 6 = 32 bits of ticks. */
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL0_MASK (WHEEL0_SIZE - 1)
+#define WHEELN_MASK (WHEELN_SIZE - 1)
+#define WHEEL_MAX_DELTA 0xffffffffLL    /* Farthest deadline the wheel covers. */
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEEL_LEVELS - 1][WHEELN_SIZE];
+static int64_t wheel_ticks;     /* Next tick the wheel will process. */
+static int64_t wheel_work;      /* # of sleepers woken or cascaded. */
+
+static void wheel_insert (struct thread *);
+static int wheel_cascade (int level);
+
+/* If true, stop the periodic tick while the idle thread is the
+   only thing that can run, and program the PIT in one-shot mode
+   for the earliest sleeper deadline instead.  Controlled by
+   kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define PIT_CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot the 16-bit PIT counter can time, in ticks. */
+#define TICKLESS_MAX_TICKS (PIT_MAX_COUNT / PIT_CYCLES_PER_TICK)
+
+static int64_t oneshot_ticks;           /* Ticks the armed one-shot covers, 0 if none. */
+static int64_t timer_interrupts;        /* # of timer interrupts taken. */
+static int64_t tickless_skipped;        /* # of ticks that raised no interrupt. */
+
+static void timer_catch_up (int64_t cnt);
+static void timer_restart_periodic (void);
 
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
@@ -38,8 +80,14 @@ timer_init (void)
 {
     pit_configure_channel (0, 2, TIMER_FREQ);
     intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-    list_init(&sleeping_threads);
 
+    int i, level;
+    for (i = 0; i < WHEEL0_SIZE; i++)
+        list_init (&wheel0[i]);
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        for (i = 0; i < WHEELN_SIZE; i++)
+            list_init (&wheeln[level][i]);
+    wheel_ticks = ticks;
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -106,10 +154,9 @@ timer_sleep (int64_t ticks) {
      * so wakeUpTime represents the number of ticks left to wake*/
     currentThread->wakeUpTime = start + ticks;
 
-    /* list is ordered ascendingly such that the thread with the earliest wake up time is at the front
-     * and when reached a thread with wake Up time > ticks breat the loop to insure optimisation*/
-
-    list_insert_ordered(&sleeping_threads, &currentThread->elem,compare_wakeUpTime, NULL);
+    /* hang the thread on the timing wheel slot for its wake up time, checkToWakeUPNow()
+     * unblocks it once the wheel reaches that slot*/
+    wheel_insert(currentThread);
     //block current thread
     thread_block();
 
@@ -184,12 +231,116 @@ void
 timer_print_stats (void)
 {
     printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+    if (timer_tickless)
+        printf ("Timer: %"PRId64" interrupts, %"PRId64" ticks skipped while idle\n",
+                timer_interrupts, tickless_skipped);
+}
+
+/* Called by the idle thread, with interrupts off and nothing in
+   the run queue, right before it halts the CPU.  In tickless mode,
+   replaces the periodic tick by a single PIT interrupt at the
+   earliest sleeper deadline, as far out as the PIT can count. */
+void
+timer_idle_enter (void)
+{
+    int64_t cnt;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (!timer_tickless || oneshot_ticks != 0)
+        return;
+
+    /* Find how many ticks we can go without a wake-up.  A wrap of
+       the wheel's first level counts as a wake-up too, since the
+       cascade it triggers may bring due sleepers down to level 0. */
+    for (cnt = 0; cnt < TICKLESS_MAX_TICKS; cnt++)
+    {
+        int index = (wheel_ticks + cnt) & WHEEL0_MASK;
+        if (!list_empty (&wheel0[index]) || index == 0)
+            break;
+    }
+    cnt++;
+    if (cnt > TICKLESS_MAX_TICKS)
+        cnt = TICKLESS_MAX_TICKS;
+    if (cnt <= 1)
+        return;
+
+    pit_configure_oneshot (0, cnt * PIT_CYCLES_PER_TICK);
+    oneshot_ticks = cnt;
+}
+
+/* Called by the idle thread right after the halted CPU resumes.
+   If an interrupt other than the timer's woke us up, the one-shot
+   is still armed: account for the ticks that have elapsed so far
+   and go back to the periodic tick, since someone may be about to
+   run and needs time slices. */
+void
+timer_idle_exit (void)
+{
+    enum intr_level old_level = intr_disable ();
+
+    if (oneshot_ticks != 0)
+    {
+        bool fired;
+        uint16_t left = pit_read_counter (0, &fired);
+
+        /* If the one-shot already fired, its interrupt is pending
+           and timer_interrupt() will do the accounting. */
+        if (!fired)
+        {
+            int64_t elapsed = (oneshot_ticks * PIT_CYCLES_PER_TICK - left)
+                              / PIT_CYCLES_PER_TICK;
+            timer_restart_periodic ();
+            timer_catch_up (elapsed);
+        }
+    }
+    intr_set_level (old_level);
+}
+
+/* Accounts for CNT ticks that went by without a timer interrupt
+   while the CPU was idle. */
+static void
+timer_catch_up (int64_t cnt)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (cnt <= 0)
+        return;
+    ticks += cnt;
+    tickless_skipped += cnt;
+    thread_idle_catch_up (cnt);
+    checkToWakeUPNow ();
+}
+
+/* Disarms the one-shot and goes back to TIMER_FREQ interrupts per
+   second. */
+static void
+timer_restart_periodic (void)
+{
+    oneshot_ticks = 0;
+    pit_configure_channel (0, 2, TIMER_FREQ);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+    timer_interrupts++;
+    if (oneshot_ticks != 0)
+    {
+        /* If the one-shot fired, it covered ONESHOT_TICKS ticks: this
+           interrupt is the last of them and the ones before it were
+           skipped.  Otherwise this is a periodic tick that was already
+           pending when the one-shot was armed, so just disarm it. */
+        bool fired;
+        int64_t skipped = oneshot_ticks - 1;
+
+        pit_read_counter (0, &fired);
+        timer_restart_periodic ();
+        if (fired)
+            timer_catch_up (skipped);
+    }
+
     ticks++;
     thread_tick ();
 
@@ -199,20 +350,145 @@ timer_interrupt (struct intr_frame *args UNUSED)
 
 }
 void checkToWakeUPNow(){
-    struct list_elem *element;
-    struct thread *currentThread;
-    while(!list_empty(&sleeping_threads)){
-        element = list_front(&sleeping_threads);//get the first element in the list
-        currentThread = list_entry(element, struct thread, elem);
-        if (currentThread->wakeUpTime <= ticks){ //time to wake up
-            list_remove(element); //remove from sleeping
-            thread_unblock(currentThread); //unblock the thread
-        } else {
-            /*found a thread with wake up time > ticks so break the loop*
-             * bec  the list is sorted asendingly we are sure all next wakeUpTimes >= current wakeUpTime which is > ticks*/
-            return;
+    /* advance the wheel one slot at a time until it catches up with ticks,
+     * waking every thread hung on a level 0 slot it passes*/
+    while (wheel_ticks <= ticks){
+        int index = wheel_ticks & WHEEL0_MASK;
+        struct list *slot = &wheel0[index];
+        int level;
+
+        /*level 0 wrapped around, so pull the next slot of each higher level down
+         * until we hit a level that did not wrap as well*/
+        if (index == 0)
+            for (level = 1; level < WHEEL_LEVELS && wheel_cascade(level) == 0; level++)
+                continue;
+
+        while (!list_empty(slot)){
+            struct thread *currentThread = list_entry(list_pop_front(slot), struct thread, sleepelem);
+            wheel_work++;
+            if (currentThread->timed_wait){
+                //a timed wait ran out, take the thread off whatever it waits for as well
+                currentThread->timed_wait = false;
+                synch_wait_expired(currentThread);
+            }
+            else
+                thread_unblock(currentThread); //unblock the thread
+        }
+        wheel_ticks++;
+    }
+}
+
+/* Returns the number of sleepers the timing wheel has woken up or
+   cascaded down a level since boot.  Dividing deltas of this by
+   elapsed ticks gives the average per-tick expiry cost. */
+int64_t
+timer_wheel_work (void)
+{
+    enum intr_level old_level = intr_disable ();
+    int64_t work = wheel_work;
+    intr_set_level (old_level);
+    return work;
+}
+
+/* Bounds the current thread's next waits on a semaphore or lock
+   (see synch.c) by putting it on the timing wheel for DEADLINE,
+   in timer ticks since boot, without blocking.  If the deadline
+   passes first, the thread is taken off the waiters, woken up and
+   its timed_out flag set.  Must be called with interrupts off. */
+void
+timer_timeout_arm (int64_t deadline)
+{
+    struct thread *t = thread_current ();
+
+    ASSERT (intr_get_level () == INTR_OFF);
+    ASSERT (!t->timed_wait);
+
+    t->wakeUpTime = deadline;
+    t->timed_out = false;
+    t->timed_wait = true;
+    wheel_insert (t);
+}
+
+/* Ends the current thread's timed wait, taking it off the timing
+   wheel if its deadline has not passed yet.  Must be called with
+   interrupts off. */
+void
+timer_timeout_cancel (void)
+{
+    struct thread *t = thread_current ();
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (t->timed_wait)
+    {
+        list_remove (&t->sleepelem);
+        t->timed_wait = false;
+    }
+}
+
+/* Puts sleeping thread T on the timing wheel slot for its
+   wakeUpTime.  Must be called with interrupts off. */
+static void
+wheel_insert (struct thread *t)
+{
+    int64_t expires = t->wakeUpTime;
+    int64_t delta = expires - wheel_ticks;
+    struct list *slot;
+    int level;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (delta < 0)
+    {
+        /* Already due: wake it on the next tick the wheel processes. */
+        list_push_back (&wheel0[wheel_ticks & WHEEL0_MASK], &t->sleepelem);
+        return;
+    }
+    if (delta < WHEEL0_SIZE)
+    {
+        list_push_back (&wheel0[expires & WHEEL0_MASK], &t->sleepelem);
+        return;
+    }
+    if (delta > WHEEL_MAX_DELTA)
+    {
+        /* Too far out: park it in the last slot the wheel covers.  It
+           gets re-sorted with its real wakeUpTime when cascaded. */
+        delta = WHEEL_MAX_DELTA;
+        expires = wheel_ticks + delta;
+    }
+
+    slot = NULL;
+    for (level = 1; level < WHEEL_LEVELS; level++)
+    {
+        int shift = WHEEL0_BITS + (level - 1) * WHEELN_BITS;
+        if (level == WHEEL_LEVELS - 1
+            || delta < (int64_t) 1 << (shift + WHEELN_BITS))
+        {
+            slot = &wheeln[level - 1][(expires >> shift) & WHEELN_MASK];
+            break;
         }
     }
+    list_push_back (slot, &t->sleepelem);
+}
+
+/* Moves every sleeper in the current slot of LEVEL down to the
+   levels below it, and returns that slot's index.  A return value
+   of 0 means LEVEL wrapped around too, so the level above it must be
+   cascaded as well. */
+static int
+wheel_cascade (int level)
+{
+    int shift = WHEEL0_BITS + (level - 1) * WHEELN_BITS;
+    int index = (wheel_ticks >> shift) & WHEELN_MASK;
+    struct list *slot = &wheeln[level - 1][index];
+
+    while (!list_empty (slot))
+    {
+        struct thread *t = list_entry (list_pop_front (slot), struct thread, sleepelem);
+        wheel_work++;
+        wheel_insert (t);
+    }
+    return index;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
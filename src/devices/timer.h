@@ -2,11 +2,16 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* If true, stop the periodic tick when idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -19,12 +24,21 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Timed waits (see synch.c). */
+void timer_timeout_arm (int64_t deadline);
+void timer_timeout_cancel (void);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
+int64_t timer_wheel_work (void);
+
+/* Tickless idle. */
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 /*##########       ADDED        ############*/
 void checkToWakeUPNow();
@@ -0,0 +1,45 @@
+/* thrash.c
+
+   Matrix multiplication, as in matmult.c, on matrices too big to
+   fit in memory together, to measure swap throughput.
+
+   The three 512x512 matrices take 3 MB, and the multiplication
+   walks B a column at a time, touching a different page of B on
+   every step of the inner loop.  Run it with a swap disk and
+   less user memory than that, e.g.
+     pintos -m 4 --swap-size=8 -p thrash -a thrash -- -q run thrash
+   and read the pages/s figure on the "Swap:" line that the kernel
+   prints at shutdown. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+#define DIM 512
+
+int A[DIM][DIM];
+int B[DIM][DIM];
+int C[DIM][DIM];
+
+int
+main (void)
+{
+  int i, j, k;
+
+  /* Initialize the matrices. */
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      {
+	A[i][j] = i;
+	B[i][j] = j;
+	C[i][j] = 0;
+      }
+
+  /* Multiply matrices. */
+  for (i = 0; i < DIM; i++)	
+    for (j = 0; j < DIM; j++)
+      for (k = 0; k < DIM; k++)
+	C[i][j] += A[i][k] * B[k][j];
+
+  /* Done. */
+  exit (C[DIM - 1][DIM - 1]);
+}
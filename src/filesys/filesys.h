@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
+#include "threads/synch.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
@@ -11,6 +12,12 @@
 /* Block device that contains the file system. */
 extern struct block *fs_device;
 
+/* The file system does no locking of its own, so every call into
+   it from a thread that may run alongside others must hold this
+   lock.  It must not be held while touching user memory, because
+   the page fault handler may need it to read a page in. */
+extern struct lock filesys_lock;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
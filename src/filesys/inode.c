@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -57,11 +58,17 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of `struct inode's. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0, NULL);
+  if (inode_cache == NULL)
+    PANIC ("inode_init: out of memory");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -127,7 +134,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -181,7 +188,7 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
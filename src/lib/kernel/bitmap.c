@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -23,11 +24,22 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Alongside the bits is a summary with one bit per element of
+   BITS, set when every bit in that element is set to true.  A
+   scan for false bits uses it to step over ELEM_BITS full
+   elements at a time, so long stretches of used space cost one
+   load per ELEM_BITS * ELEM_BITS bits.  Each bit is still set
+   atomically, but its element's summary bit is updated
+   separately, so concurrent changes to one bitmap must be
+   serialized by the caller, just as scanning and setting bits
+   already must be. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *full;    /* Summary: which elements are all true. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -68,6 +80,128 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a bit mask of the bits of element IDX in B that are
+   actually used. */
+static inline elem_type
+used_mask (const struct bitmap *b, size_t idx)
+{
+  return idx + 1 < elem_cnt (b->bit_cnt) ? (elem_type) -1 : last_mask (b);
+}
+
+/* Returns a bit mask of the bits in an element from bit OFS
+   through bit OFS + CNT - 1.  OFS + CNT must not exceed
+   ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type mask = cnt < ELEM_BITS ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1;
+  return mask << ofs;
+}
+
+/* Returns the number of 1-bits in E.  GCC's builtin for this
+   needs libgcc, which the kernel does not link against. */
+static inline int
+popcount (elem_type e)
+{
+  e = e - ((e >> 1) & 0x55555555);
+  e = (e & 0x33333333) + ((e >> 2) & 0x33333333);
+  e = (e + (e >> 4)) & 0x0f0f0f0f;
+  return (e * 0x01010101) >> 24;
+}
+
+/* Returns the number of elements in the summary of a bitmap of
+   BIT_CNT bits. */
+static inline size_t
+summary_cnt (size_t bit_cnt)
+{
+  return elem_cnt (elem_cnt (bit_cnt));
+}
+
+/* Brings the summary bit for element IDX of B up to date. */
+static inline void
+update_summary (struct bitmap *b, size_t idx)
+{
+  elem_type mask = bit_mask (idx);
+  if (b->bits[idx] == used_mask (b, idx))
+    b->full[elem_idx (idx)] |= mask;
+  else
+    b->full[elem_idx (idx)] &= ~mask;
+}
+
+/* Atomically sets the bits in MASK in element IDX of B to
+   VALUE, then updates the summary. */
+static void
+set_elem_bits (struct bitmap *b, size_t idx, elem_type mask, bool value)
+{
+  /* These are equivalent to `b->bits[idx] |= mask' and
+     `b->bits[idx] &= ~mask' except that they are guaranteed to be
+     atomic on a uniprocessor machine.  See the descriptions of
+     the OR and AND instructions in [IA32-v2b] and [IA32-v2a]. */
+  if (value)
+    asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  else
+    asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
+}
+
+/* Returns element IDX of B with each bit that is set to VALUE
+   turned on and the rest turned off. */
+static inline elem_type
+elem_matching (const struct bitmap *b, size_t idx, bool value)
+{
+  return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the index of the first element at or after IDX in B
+   that is not full according to the summary, or a value not
+   less than elem_cnt (B's size) if there is none. */
+static size_t
+skip_full (const struct bitmap *b, size_t idx)
+{
+  size_t sidx = elem_idx (idx);
+  size_t scnt = summary_cnt (b->bit_cnt);
+  elem_type s;
+
+  if (sidx >= scnt)
+    return idx;
+  s = ~b->full[sidx] & ((elem_type) -1 << (idx % ELEM_BITS));
+  while (s == 0)
+    {
+      if (++sidx >= scnt)
+        return sidx * ELEM_BITS;
+      s = ~b->full[sidx];
+    }
+  return sidx * ELEM_BITS + __builtin_ctzl (s);
+}
+
+/* Returns the index of the first bit at or after START in B that
+   is set to VALUE, or B's size if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value)
+{
+  size_t cnt = elem_cnt (b->bit_cnt);
+  size_t idx = elem_idx (start);
+  size_t bit_idx;
+  elem_type e;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  e = elem_matching (b, idx, value) & ((elem_type) -1 << (start % ELEM_BITS));
+  while (e == 0)
+    {
+      idx++;
+      if (!value)
+        idx = skip_full (b, idx);
+      if (idx >= cnt)
+        return b->bit_cnt;
+      e = elem_matching (b, idx, value);
+    }
+
+  bit_idx = idx * ELEM_BITS + __builtin_ctzl (e);
+  return bit_idx < b->bit_cnt ? bit_idx : b->bit_cnt;
+}
 
 /* Creation and destruction. */
 
@@ -83,11 +217,15 @@ bitmap_create (size_t bit_cnt)
     {
       b->bit_cnt = bit_cnt;
       b->bits = malloc (byte_cnt (bit_cnt));
-      if (b->bits != NULL || bit_cnt == 0)
+      b->full = malloc (byte_cnt (elem_cnt (bit_cnt)));
+      if ((b->bits != NULL && b->full != NULL) || bit_cnt == 0)
         {
+          memset (b->full, 0, byte_cnt (elem_cnt (bit_cnt)));
           bitmap_set_all (b, false);
           return b;
         }
+      free (b->bits);
+      free (b->full);
       free (b);
     }
   return NULL;
@@ -105,6 +243,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->full = b->bits + elem_cnt (bit_cnt);
+  memset (b->full, 0, byte_cnt (elem_cnt (bit_cnt)));
   bitmap_set_all (b, false);
   return b;
 }
@@ -114,7 +254,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 size_t
 bitmap_buf_size (size_t bit_cnt) 
 {
-  return sizeof (struct bitmap) + byte_cnt (bit_cnt);
+  return sizeof (struct bitmap) + byte_cnt (bit_cnt)
+         + byte_cnt (elem_cnt (bit_cnt));
 }
 
 /* Destroys bitmap B, freeing its storage.
@@ -125,6 +266,7 @@ bitmap_destroy (struct bitmap *b)
   if (b != NULL) 
     {
       free (b->bits);
+      free (b->full);
       free (b);
     }
 }
@@ -163,6 +305,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,6 +319,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +335,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +358,24 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each bit is set atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+
+      set_elem_bits (b, elem_idx (start), range_mask (ofs, n), value);
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,16 +383,23 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+
+      value_cnt += popcount (elem_matching (b, elem_idx (start), value)
+                             & range_mask (ofs, n));
+      start += n;
+      cnt -= n;
+    }
   return value_cnt;
 }
 
@@ -250,15 +408,20 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+
+      if (elem_matching (b, elem_idx (start), value) & range_mask (ofs, n))
+        return true;
+      start += n;
+      cnt -= n;
+    }
   return false;
 }
 
@@ -291,20 +454,30 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Rather than trying every starting index, jumps from each run
+   of bits set to VALUE to the next, a word at a time, so the
+   cost is linear in the size of B whatever CNT is. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt == 0)
+    return start;
+  while (cnt <= b->bit_cnt - start)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t run_start = find_next (b, start, value);
+      size_t run_end;
+
+      if (cnt > b->bit_cnt - run_start)
+        break;
+      run_end = find_next (b, run_start, !value);
+      if (run_end - run_start >= cnt)
+        return run_start;
+      start = run_end;
     }
   return BITMAP_ERROR;
 }
@@ -344,8 +517,12 @@ bitmap_read (struct bitmap *b, struct file *file)
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
+      size_t idx;
+
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      for (idx = 0; idx < elem_cnt (b->bit_cnt); idx++)
+        update_summary (b, idx);
     }
   return success;
 }
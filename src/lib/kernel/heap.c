@@ -0,0 +1,191 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* Pairing heap.  Each element has a list of children, linked
+   through `next' and `prev' and hung off its `child' member; the
+   leftmost child's `prev' points back to the parent instead of to
+   a sibling.  Every element is at least as great as its
+   children, so the root is the greatest element.
+
+   Two heaps are melded by making the root that is not greater a
+   child of the other one.  Removing the root leaves a list of
+   subheaps, which are melded back together in two passes: first
+   in pairs from left to right, then the pairs from right to left.
+   This pairing is what gives the O(log n) amortized bound. */
+
+static struct heap_elem *meld (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux)
+{
+  ASSERT (heap != NULL);
+  ASSERT (less != NULL);
+
+  heap->root = NULL;
+  heap->size = 0;
+  heap->less = less;
+  heap->aux = aux;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap)
+{
+  return heap->root == NULL;
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap)
+{
+  return heap->size;
+}
+
+/* Returns the greatest element in HEAP, without removing it.
+   HEAP must not be empty. */
+struct heap_elem *
+heap_max (const struct heap *heap)
+{
+  ASSERT (!heap_empty (heap));
+  return heap->root;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_insert (struct heap *heap, struct heap_elem *elem)
+{
+  ASSERT (elem != NULL);
+
+  elem->child = elem->next = elem->prev = NULL;
+  heap->root = meld (heap, heap->root, elem);
+  heap->size++;
+}
+
+/* Removes the greatest element from HEAP and returns it.  HEAP
+   must not be empty. */
+struct heap_elem *
+heap_pop_max (struct heap *heap)
+{
+  struct heap_elem *max;
+
+  ASSERT (!heap_empty (heap));
+
+  max = heap->root;
+  heap->root = merge_pairs (heap, max->child);
+  heap->size--;
+  max->child = NULL;
+  return max;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem)
+{
+  struct heap_elem *sub;
+
+  ASSERT (elem != NULL);
+
+  if (elem == heap->root)
+    {
+      heap_pop_max (heap);
+      return;
+    }
+
+  /* Unlink ELEM and its subheap from its parent's list of
+     children. */
+  if (elem->prev->child == elem)
+    elem->prev->child = elem->next;
+  else
+    elem->prev->next = elem->next;
+  if (elem->next != NULL)
+    elem->next->prev = elem->prev;
+
+  /* Meld ELEM's children back into the heap. */
+  sub = merge_pairs (heap, elem->child);
+  heap->root = meld (heap, heap->root, sub);
+  heap->size--;
+  elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Restores HEAP's ordering after the key of ELEM, which must be
+   in HEAP, has changed. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem)
+{
+  heap_remove (heap, elem);
+  heap_insert (heap, elem);
+}
+
+/* Melds the heaps rooted at A and B, either of which may be
+   null, and returns the root of the result. */
+static struct heap_elem *
+meld (struct heap *heap, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (heap->less (a, b, heap->aux))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* B becomes A's leftmost child. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Melds the list of sibling subheaps starting at FIRST into a
+   single heap and returns its root, or a null pointer if FIRST
+   is null. */
+static struct heap_elem *
+merge_pairs (struct heap *heap, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: meld siblings in pairs from left to right,
+     stacking the results on PAIRS through their `next'
+     members. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+      struct heap_elem *pair;
+
+      if (b != NULL)
+        {
+          first = b->next;
+          b->next = b->prev = NULL;
+        }
+      else
+        first = NULL;
+      a->next = a->prev = NULL;
+
+      pair = meld (heap, a, b);
+      pair->next = pairs;
+      pairs = pair;
+    }
+
+  /* Second pass: meld the pairs from right to left. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+      pairs->next = NULL;
+      root = meld (heap, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
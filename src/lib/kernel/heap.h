@@ -0,0 +1,69 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Max-heap (priority queue).
+
+   This is an intrusive pairing heap.  Like the linked list and
+   hash table, it does not use dynamic allocation: each structure
+   that can potentially be in a heap must embed a struct
+   heap_elem member, and the heap_entry macro converts a struct
+   heap_elem back to the structure that contains it.  Refer to
+   lib/kernel/list.h for a detailed explanation of the technique.
+
+   The element that compares greatest under the heap's
+   heap_less_func is always at the top.  Inserting an element
+   takes O(1) time; removing the top or an arbitrary element, or
+   repositioning one after its key changed, takes O(log n)
+   amortized time.
+
+   An element's key must not change while it is in a heap, except
+   immediately before a call to heap_update() on that element. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* Leftmost child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent if leftmost. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Greatest element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+bool heap_empty (const struct heap *);
+size_t heap_size (const struct heap *);
+struct heap_elem *heap_max (const struct heap *);
+
+void heap_insert (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop_max (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,123 @@
+/* Puts growing numbers of threads to sleep at once, up to
+   several thousand, and measures how much work the timer
+   interrupt does per tick while they are all asleep.  With the
+   timing wheel that cost must stay flat no matter how many
+   sleepers there are.  Also verifies that no sleeper wakes up
+   before its requested time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of ticks over which per-tick cost is measured. */
+#define WINDOW 100
+
+/* Sleepers wake up at least this many ticks after the round
+   starts, which leaves room for creating them and for the
+   measurement window, plus a full turn of the wheel's first
+   level so that no cascade touches them during the window. */
+#define WAKE_DELAY 700
+
+/* Information about the test. */
+struct stress_test
+  {
+    int64_t wake_base;          /* Earliest wake-up time. */
+    struct lock lock;           /* Lock protecting early_cnt. */
+    int early_cnt;              /* # of sleepers that woke up early. */
+    struct semaphore done;      /* Upped by each sleeper on wake-up. */
+  };
+
+/* Information about an individual sleeper. */
+struct stress_sleeper
+  {
+    struct stress_test *test;   /* Info shared between all sleepers. */
+    int64_t wake_time;          /* Tick to wake up at. */
+  };
+
+static void sleeper (void *);
+static void stress_round (int sleeper_cnt);
+
+void
+test_alarm_stress (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  stress_round (10);
+  stress_round (100);
+  stress_round (1000);
+  stress_round (5000);
+}
+
+/* Puts SLEEPER_CNT threads to sleep and checks the per-tick
+   timer cost while they sleep. */
+static void
+stress_round (int sleeper_cnt)
+{
+  struct stress_test test;
+  struct stress_sleeper *sleepers;
+  int64_t work;
+  int i;
+
+  sleepers = malloc (sizeof *sleepers * sleeper_cnt);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  test.wake_base = timer_ticks () + WAKE_DELAY;
+  lock_init (&test.lock);
+  test.early_cnt = 0;
+  sema_init (&test.done, 0);
+
+  for (i = 0; i < sleeper_cnt; i++)
+    {
+      struct stress_sleeper *s = sleepers + i;
+      char name[24];
+
+      s->test = &test;
+      s->wake_time = test.wake_base + i % 64;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, s) == TID_ERROR)
+        fail ("couldn't create sleeper %d of %d", i, sleeper_cnt);
+    }
+
+  /* Let every sleeper run and go to sleep, then measure. */
+  timer_sleep (1);
+  work = timer_wheel_work ();
+  timer_sleep (WINDOW);
+  work = timer_wheel_work () - work;
+
+  /* The only wake-up expected during the window is our own. */
+  if (work > WINDOW / 10)
+    fail ("%d sleepers: timer did %lld units of work in %d ticks",
+          sleeper_cnt, work, WINDOW);
+
+  for (i = 0; i < sleeper_cnt; i++)
+    sema_down (&test.done);
+  if (test.early_cnt != 0)
+    fail ("%d of %d sleepers woke up early", test.early_cnt, sleeper_cnt);
+
+  msg ("%d sleepers: per-tick cost flat, all woke up on time.",
+       sleeper_cnt);
+  free (sleepers);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *s_)
+{
+  struct stress_sleeper *s = s_;
+  struct stress_test *test = s->test;
+
+  timer_sleep (s->wake_time - timer_ticks ());
+  if (timer_ticks () < s->wake_time)
+    {
+      lock_acquire (&test->lock);
+      test->early_cnt++;
+      lock_release (&test->lock);
+    }
+  sema_up (&test->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-stress) begin
+(alarm-stress) 10 sleepers: per-tick cost flat, all woke up on time.
+(alarm-stress) 100 sleepers: per-tick cost flat, all woke up on time.
+(alarm-stress) 1000 sleepers: per-tick cost flat, all woke up on time.
+(alarm-stress) 5000 sleepers: per-tick cost flat, all woke up on time.
+(alarm-stress) end
+EOF
+pass;
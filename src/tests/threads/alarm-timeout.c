@@ -0,0 +1,103 @@
+/* Checks the timed waits in synch.c.  A semaphore, lock and
+   condition variable that nobody signals must time out no sooner
+   than asked.  A waiter that is signaled before its timeout must
+   get what it waited for and leave no stale entry behind on the
+   timing wheel.  A lock waiter that gives up must stop donating
+   its priority to the lock's holder. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static struct semaphore sema;
+static struct lock lock;
+static struct condition cond;
+
+static thread_func sema_waiter;
+static thread_func lock_waiter;
+static thread_func cond_waiter;
+
+void
+test_alarm_timeout (void)
+{
+  int64_t start;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&sema, 0);
+  lock_init (&lock);
+  cond_init (&cond);
+
+  /* Semaphore. */
+  start = timer_ticks ();
+  if (sema_down_timeout (&sema, 10) || timer_elapsed (start) < 10)
+    fail ("sema_down_timeout did not time out after 10 ticks");
+  msg ("sema_down_timeout timed out.");
+  thread_create ("sema waiter", PRI_DEFAULT + 1, sema_waiter, NULL);
+  sema_up (&sema);
+
+  /* Lock. */
+  lock_acquire (&lock);
+  thread_create ("lock waiter", PRI_DEFAULT + 5, lock_waiter, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  timer_sleep (50);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  lock_release (&lock);
+
+  /* Condition variable. */
+  lock_acquire (&lock);
+  start = timer_ticks ();
+  if (cond_wait_timeout (&cond, &lock, 10) || timer_elapsed (start) < 10)
+    fail ("cond_wait_timeout did not time out after 10 ticks");
+  if (!lock_held_by_current_thread (&lock))
+    fail ("cond_wait_timeout returned without the lock");
+  msg ("cond_wait_timeout timed out.");
+  lock_release (&lock);
+  thread_create ("cond waiter", PRI_DEFAULT + 1, cond_waiter, NULL);
+  lock_acquire (&lock);
+  cond_signal (&cond, &lock);
+  lock_release (&lock);
+
+  /* Outlive every timeout above, so that a stale timing wheel
+     entry would fire. */
+  timer_sleep (200);
+  msg ("Main thread finished.");
+}
+
+static void
+sema_waiter (void *aux UNUSED)
+{
+  msg ("sema waiter waiting.");
+  if (!sema_down_timeout (&sema, 100))
+    fail ("sema waiter timed out");
+  msg ("sema waiter got the semaphore.");
+}
+
+static void
+lock_waiter (void *aux UNUSED)
+{
+  msg ("lock waiter waiting.");
+  if (lock_acquire_timeout (&lock, 20))
+    fail ("lock waiter got the lock");
+  msg ("lock waiter gave up on the lock.");
+}
+
+static void
+cond_waiter (void *aux UNUSED)
+{
+  lock_acquire (&lock);
+  msg ("cond waiter waiting.");
+  if (!cond_wait_timeout (&cond, &lock, 100))
+    fail ("cond waiter timed out");
+  msg ("cond waiter was signaled.");
+  lock_release (&lock);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-timeout) begin
+(alarm-timeout) sema_down_timeout timed out.
+(alarm-timeout) sema waiter waiting.
+(alarm-timeout) sema waiter got the semaphore.
+(alarm-timeout) lock waiter waiting.
+(alarm-timeout) Main thread should have priority 36.  Actual priority: 36.
+(alarm-timeout) lock waiter gave up on the lock.
+(alarm-timeout) Main thread should have priority 31.  Actual priority: 31.
+(alarm-timeout) cond_wait_timeout timed out.
+(alarm-timeout) cond waiter waiting.
+(alarm-timeout) cond waiter was signaled.
+(alarm-timeout) Main thread finished.
+(alarm-timeout) end
+EOF
+pass;
@@ -0,0 +1,98 @@
+/* Measures bitmap scanning on a 1M-bit map that is 90% used, the
+   way a long-running allocator's map looks: most 4,096-bit
+   chunks are entirely used, and the rest are half used at
+   random.  Scans for runs of several lengths from random
+   starting points, checking each result against a bit-by-bit
+   reference scan, and reports how long the scans take. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+
+#define BIT_CNT (1024 * 1024)
+#define CHUNK_BITS 4096
+#define SCAN_CNT 1000
+
+static size_t starts[SCAN_CNT];
+
+static size_t reference_scan (const struct bitmap *, size_t start,
+                              size_t cnt);
+
+void
+test_bitmap_scan (void)
+{
+  static const size_t run_cnts[] = {1, 4, 16};
+  struct bitmap *b;
+  size_t chunk, i, used;
+  int64_t start;
+  size_t r;
+
+  b = bitmap_create (BIT_CNT);
+  if (b == NULL)
+    fail ("couldn't create bitmap");
+
+  random_init (0);
+  for (chunk = 0; chunk < BIT_CNT; chunk += CHUNK_BITS)
+    if (random_ulong () % 5 != 0)
+      bitmap_set_multiple (b, chunk, CHUNK_BITS, true);
+    else
+      for (i = chunk; i < chunk + CHUNK_BITS; i++)
+        bitmap_set (b, i, random_ulong () % 2);
+  used = bitmap_count (b, 0, BIT_CNT, true);
+  msg ("%zu of %d bits used.", used, BIT_CNT);
+
+  for (r = 0; r < sizeof run_cnts / sizeof *run_cnts; r++)
+    {
+      size_t cnt = run_cnts[r];
+      int64_t elapsed;
+      int n;
+
+      for (n = 0; n < SCAN_CNT; n++)
+        starts[n] = random_ulong () % BIT_CNT;
+
+      start = timer_ticks ();
+      for (n = 0; n < SCAN_CNT; n++)
+        bitmap_scan (b, starts[n], cnt, false);
+      elapsed = timer_elapsed (start);
+      msg ("%d scans for %zu free bits in %lld ticks.",
+           SCAN_CNT, cnt, elapsed);
+
+      for (n = 0; n < SCAN_CNT; n += SCAN_CNT / 50)
+        {
+          size_t expected = reference_scan (b, starts[n], cnt);
+          size_t actual = bitmap_scan (b, starts[n], cnt, false);
+          if (actual != expected)
+            fail ("scan for %zu bits from %zu found %zu, expected %zu",
+                  cnt, starts[n], actual, expected);
+        }
+    }
+
+  /* A scan from the start for a run that does not exist has to
+     look at the whole map. */
+  start = timer_ticks ();
+  if (bitmap_scan (b, 0, CHUNK_BITS, false) != BITMAP_ERROR)
+    fail ("found a free run no chunk has");
+  msg ("Failed scan of the whole map in %lld ticks.", timer_elapsed (start));
+
+  bitmap_destroy (b);
+  msg ("PASS");
+}
+
+/* Returns the first run of CNT false bits at or after START in
+   B, checking bit by bit, or BITMAP_ERROR. */
+static size_t
+reference_scan (const struct bitmap *b, size_t start, size_t cnt)
+{
+  size_t run = 0;
+  size_t i;
+
+  for (i = start; i < bitmap_size (b); i++)
+    if (bitmap_test (b, i))
+      run = 0;
+    else if (++run == cnt)
+      return i + 1 - cnt;
+  return BITMAP_ERROR;
+}
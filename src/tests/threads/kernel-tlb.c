@@ -0,0 +1,68 @@
+/* Measures the cost of touching many kernel pages in random
+   order, which depends on how many TLB entries the kernel's
+   mapping of physical memory needs.  With 4 MB pages a handful
+   of entries cover all of it; with 4 kB pages each page touched
+   needs its own.  Compare a run with the -no-pse kernel option
+   against one without.  Also checks that every page reads back
+   what was written to it through the mapping. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 1024
+#define ROUND_CNT 1000
+
+/* Each round touches one of this many bytes in each page. */
+#define SLOT_CNT 64
+#define SLOT_SIZE (PGSIZE / SLOT_CNT)
+
+static uint8_t *pages[PAGE_CNT];
+
+void
+test_kernel_tlb (void)
+{
+  int64_t start, elapsed;
+  int i, slot, round;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+
+  /* Visit the pages in random order. */
+  random_init (0);
+  for (i = PAGE_CNT - 1; i > 0; i--)
+    {
+      int j = random_ulong () % (i + 1);
+      uint8_t *tmp = pages[i];
+      pages[i] = pages[j];
+      pages[j] = tmp;
+    }
+
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < PAGE_CNT; i++)
+      pages[i][round % SLOT_CNT * SLOT_SIZE]++;
+  elapsed = timer_elapsed (start);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      for (slot = 0; slot < SLOT_CNT; slot++)
+        {
+          int expected = ROUND_CNT / SLOT_CNT + (slot < ROUND_CNT % SLOT_CNT);
+          if (pages[i][slot * SLOT_SIZE] != expected)
+            fail ("page %d slot %d is %d, expected %d",
+                  i, slot, pages[i][slot * SLOT_SIZE], expected);
+        }
+      palloc_free_page (pages[i]);
+    }
+
+  msg ("Kernel maps physical memory with %zu 4 MB pages.",
+       init_large_page_cnt);
+  msg ("%d page touches in %lld ticks.", PAGE_CNT * ROUND_CNT, elapsed);
+  msg ("PASS");
+}
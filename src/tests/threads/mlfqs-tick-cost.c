@@ -0,0 +1,76 @@
+/* Creates 1,000 threads that block on a semaphore, then spins
+   for a few seconds and counts how many per-thread MLFQS
+   recomputations the timer interrupt performs.  Only the running
+   thread's priority changes every four ticks and blocked threads
+   catch up lazily when they wake, so the count must not grow with
+   the number of blocked threads.  Recomputing every thread every
+   four ticks, as the MLFQS description suggests, would do about
+   250 per tick here. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define SPIN_SECONDS 3
+
+static void blocker (void *);
+
+/* Semaphores shared with the blocked threads. */
+static struct semaphore release;
+static struct semaphore done;
+
+void
+test_mlfqs_tick_cost (void)
+{
+  int64_t start_time, ticks, updates;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&release, 0);
+  sema_init (&done, 0);
+
+  msg ("Creating %d threads that block.", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "blocker %d", i);
+      if (thread_create (name, PRI_DEFAULT, blocker, NULL) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  /* Let all of them run and block. */
+  timer_sleep (TIMER_FREQ);
+
+  msg ("Spinning for %d seconds...", SPIN_SECONDS);
+  start_time = timer_ticks ();
+  updates = thread_mlfqs_updates ();
+  while (timer_elapsed (start_time) < SPIN_SECONDS * TIMER_FREQ)
+    continue;
+  updates = thread_mlfqs_updates () - updates;
+  ticks = timer_elapsed (start_time);
+
+  /* One update every four ticks for the running thread, plus one
+     per second; allow up to one per tick. */
+  if (updates > ticks)
+    fail ("%lld MLFQS updates in %lld ticks with %d blocked threads",
+          updates, ticks, THREAD_CNT);
+  msg ("Tick handler cost does not depend on blocked threads.");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_up (&release);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("All threads woke up.");
+}
+
+static void
+blocker (void *aux UNUSED)
+{
+  sema_down (&release);
+  sema_up (&done);
+}
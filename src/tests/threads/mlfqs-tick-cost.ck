@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-tick-cost) begin
+(mlfqs-tick-cost) Creating 1000 threads that block.
+(mlfqs-tick-cost) Spinning for 3 seconds...
+(mlfqs-tick-cost) Tick handler cost does not depend on blocked threads.
+(mlfqs-tick-cost) All threads woke up.
+(mlfqs-tick-cost) end
+EOF
+pass;
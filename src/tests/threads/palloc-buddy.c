@@ -0,0 +1,78 @@
+/* Measures page allocator throughput and fragmentation.  Makes
+   many allocations of 1 to 16 pages from the user pool, freeing
+   random ones along the way, and reports how many operations per
+   second the allocator sustains and how much of the free memory
+   is still in large blocks.  Once everything is freed again, the
+   pool must have coalesced back to the blocks it started with. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+#define SLOT_CNT 256
+#define OP_CNT 100000
+#define MAX_PAGES 16
+
+static void *slot_pages[SLOT_CNT];
+static size_t slot_cnt[SLOT_CNT];
+
+void
+test_palloc_buddy (void)
+{
+  size_t free_before, largest_before, free_cnt, largest;
+  int64_t start, elapsed;
+  int alloc_cnt = 0, fail_cnt = 0;
+  int i;
+
+  palloc_stats (PAL_USER, &free_before, &largest_before);
+  random_init (0);
+
+  start = timer_ticks ();
+  for (i = 0; i < OP_CNT; i++)
+    {
+      int slot = random_ulong () % SLOT_CNT;
+      if (slot_pages[slot] != NULL)
+        {
+          palloc_free_multiple (slot_pages[slot], slot_cnt[slot]);
+          slot_pages[slot] = NULL;
+        }
+      else
+        {
+          slot_cnt[slot] = random_ulong () % MAX_PAGES + 1;
+          slot_pages[slot] = palloc_get_multiple (PAL_USER, slot_cnt[slot]);
+          if (slot_pages[slot] != NULL)
+            alloc_cnt++;
+          else
+            fail_cnt++;
+        }
+    }
+  elapsed = timer_elapsed (start);
+
+  palloc_stats (PAL_USER, &free_cnt, &largest);
+  msg ("%d operations in %lld ticks, %lld operations per second.",
+       OP_CNT, elapsed, OP_CNT * TIMER_FREQ / (elapsed + 1));
+  msg ("%d allocations succeeded, %d failed.", alloc_cnt, fail_cnt);
+  msg ("While in use: %zu pages free, largest free block %zu pages.",
+       free_cnt, largest);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slot_pages[i] != NULL)
+      {
+        palloc_free_multiple (slot_pages[i], slot_cnt[i]);
+        slot_pages[i] = NULL;
+      }
+
+  palloc_stats (PAL_USER, &free_cnt, &largest);
+  if (free_cnt != free_before)
+    fail ("%zu pages free after freeing everything, expected %zu",
+          free_cnt, free_before);
+  if (largest != largest_before)
+    fail ("largest free block is %zu pages after freeing everything, "
+          "expected %zu", largest, largest_before);
+  msg ("All %zu pages coalesced back into blocks of up to %zu pages.",
+       free_cnt, largest);
+  msg ("PASS");
+}
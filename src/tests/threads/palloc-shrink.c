@@ -0,0 +1,77 @@
+/* Checks that the page allocator calls a registered shrinker
+   before failing.  A test shrinker holds some user pages as a
+   pretend cache.  Allocating user pages until the pool is
+   exhausted must get every free page plus the ones the shrinker
+   gives back, and the shrinker's statistics must show them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+#define CACHE_CNT 16
+
+static void *cache[CACHE_CNT];
+static size_t cache_cnt;
+
+static size_t test_shrink (enum palloc_flags, size_t page_cnt);
+
+static struct shrinker test_shrinker =
+  {.name = "test", .priority = 0, .shrink = test_shrink};
+
+void
+test_palloc_shrink (void)
+{
+  void *held = NULL;
+  void *page;
+  size_t free_cnt, largest, got_cnt = 0;
+
+  for (cache_cnt = 0; cache_cnt < CACHE_CNT; cache_cnt++)
+    cache[cache_cnt] = palloc_get_page (PAL_USER | PAL_ASSERT);
+  shrinker_register (&test_shrinker);
+  palloc_stats (PAL_USER, &free_cnt, &largest);
+
+  /* Exhaust the user pool, chaining the pages through their first
+     words. */
+  while ((page = palloc_get_page (PAL_USER)) != NULL)
+    {
+      *(void **) page = held;
+      held = page;
+      got_cnt++;
+    }
+
+  msg ("Got %zu user pages with %zu free and %d cached.",
+       got_cnt, free_cnt, CACHE_CNT);
+  if (got_cnt != free_cnt + CACHE_CNT)
+    fail ("expected %zu pages", free_cnt + CACHE_CNT);
+  if (test_shrinker.released_cnt != CACHE_CNT)
+    fail ("shrinker statistics show %zu pages released, expected %d",
+          test_shrinker.released_cnt, CACHE_CNT);
+  msg ("Shrinker was called %u times and released %zu pages.",
+       test_shrinker.call_cnt, test_shrinker.released_cnt);
+
+  while (held != NULL)
+    {
+      page = held;
+      held = *(void **) page;
+      palloc_free_page (page);
+    }
+  shrinker_unregister (&test_shrinker);
+  msg ("PASS");
+}
+
+/* Frees the pretend cache if the user pool is short. */
+static size_t
+test_shrink (enum palloc_flags pool, size_t page_cnt UNUSED)
+{
+  size_t released = 0;
+
+  if (!(pool & PAL_USER))
+    return 0;
+  while (cache_cnt > 0)
+    {
+      palloc_free_page (cache[--cache_cnt]);
+      released++;
+    }
+  return released;
+}
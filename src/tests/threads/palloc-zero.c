@@ -0,0 +1,52 @@
+/* Checks that the idle thread keeps a stock of pre-zeroed pages.
+   Dirties and frees some pages, sleeps so that the idle thread
+   gets to run, then allocates zeroed pages, which should come
+   from the stock and must read as all zeros. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 32
+
+void
+test_palloc_zero (void)
+{
+  uint8_t *pages[PAGE_CNT];
+  long long hits, misses, hits_after, misses_after;
+  int i;
+  size_t j;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT);
+      memset (pages[i], 0x5a, PGSIZE);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+
+  /* Let the idle thread zero pages. */
+  timer_sleep (10);
+
+  palloc_zero_stats (&hits, &misses);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      for (j = 0; j < PGSIZE; j++)
+        if (pages[i][j] != 0)
+          fail ("page %d byte %zu is %#x, not zero", i, j, pages[i][j]);
+    }
+  palloc_zero_stats (&hits_after, &misses_after);
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+
+  msg ("%lld of %d zeroed pages came from the idle thread's stock.",
+       hits_after - hits, PAGE_CNT);
+  if (hits_after - hits != PAGE_CNT)
+    fail ("%lld pages were zeroed on demand", misses_after - misses);
+  msg ("PASS");
+}
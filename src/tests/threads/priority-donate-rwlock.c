@@ -0,0 +1,92 @@
+/* Two readers share an rwlock.  A writer of higher priority then
+   blocks on it and must donate its priority to both readers.  A
+   reader that arrives after the writer must wait behind it even
+   though the rwlock is only held shared, and only gets the
+   rwlock once the writer is done with it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A reader that holds the rwlock until told to let go. */
+struct reader
+  {
+    const char *name;           /* Thread name. */
+    struct semaphore go;        /* Upped to make it release. */
+  };
+
+static struct rwlock rwlock;
+
+static thread_func holding_reader;
+static thread_func late_reader;
+static thread_func writer;
+
+void
+test_priority_donate_rwlock (void)
+{
+  static const char *names[2] = {"reader A1", "reader A2"};
+  struct reader readers[2];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  for (i = 0; i < 2; i++)
+    {
+      readers[i].name = names[i];
+      sema_init (&readers[i].go, 0);
+      thread_create (readers[i].name, PRI_DEFAULT + 1, holding_reader,
+                     &readers[i]);
+    }
+  thread_create ("writer", PRI_DEFAULT + 3, writer, NULL);
+  thread_create ("reader B", PRI_DEFAULT + 2, late_reader, NULL);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+
+  for (i = 0; i < 2; i++)
+    sema_up (&readers[i].go);
+  msg ("Main thread finished.");
+}
+
+static void
+holding_reader (void *reader_)
+{
+  struct reader *reader = reader_;
+  struct rwlock_share share;
+
+  rwlock_acquire_read (&rwlock, &share);
+  msg ("%s got the rwlock shared.", reader->name);
+  sema_down (&reader->go);
+  msg ("%s should have priority %d.  Actual priority: %d.",
+       reader->name, PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_read (&rwlock, &share);
+  msg ("%s done.", reader->name);
+}
+
+static void
+late_reader (void *aux UNUSED)
+{
+  struct rwlock_share share;
+
+  msg ("reader B waiting for the rwlock.");
+  rwlock_acquire_read (&rwlock, &share);
+  msg ("reader B got the rwlock shared.");
+  rwlock_release_read (&rwlock, &share);
+  msg ("reader B done.");
+}
+
+static void
+writer (void *aux UNUSED)
+{
+  msg ("writer waiting for the rwlock.");
+  rwlock_acquire_write (&rwlock);
+  msg ("writer got the rwlock.");
+  rwlock_release_write (&rwlock);
+  msg ("writer done.");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) reader A1 got the rwlock shared.
+(priority-donate-rwlock) reader A2 got the rwlock shared.
+(priority-donate-rwlock) writer waiting for the rwlock.
+(priority-donate-rwlock) reader B waiting for the rwlock.
+(priority-donate-rwlock) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) reader A1 should have priority 34.  Actual priority: 34.
+(priority-donate-rwlock) reader A1 done.
+(priority-donate-rwlock) reader A2 should have priority 34.  Actual priority: 34.
+(priority-donate-rwlock) writer got the rwlock.
+(priority-donate-rwlock) writer done.
+(priority-donate-rwlock) reader B got the rwlock shared.
+(priority-donate-rwlock) reader B done.
+(priority-donate-rwlock) reader A2 done.
+(priority-donate-rwlock) Main thread finished.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -0,0 +1,139 @@
+/* Stresses priority donation with a deep chain and a wide fan-in.
+
+   First, the main thread drops to PRI_MIN and holds lock 0.
+   Threads 1 through 63, each one priority level higher than the
+   last, acquire their own lock K and then block on lock K - 1,
+   so that every new thread donates down a chain through all of
+   the earlier ones to the main thread.
+
+   Second, the main thread holds a single lock on which hundreds
+   of threads of assorted priorities block.  It must receive the
+   highest of their priorities, and when it releases the lock the
+   waiters must get it in priority order, first come first served
+   among equal priorities. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DEPTH (PRI_MAX - PRI_MIN)
+#define FAN 500
+
+/* Locks of the donation chain. */
+static struct lock chain_locks[DEPTH + 1];
+static int chain_done;
+
+/* Fan-in lock and the order in which its waiters got it. */
+static struct lock fan_lock;
+static int *fan_order;
+static int fan_pos;
+
+static thread_func chain_thread;
+static thread_func fan_thread;
+
+static int
+fan_priority (int id)
+{
+  return PRI_MIN + 1 + id % DEPTH;
+}
+
+void
+test_priority_donate_stress (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Deep chain. */
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i <= DEPTH; i++)
+    lock_init (&chain_locks[i]);
+  chain_done = 0;
+
+  msg ("Building a %d-deep donation chain.", DEPTH);
+  lock_acquire (&chain_locks[0]);
+  for (i = 1; i <= DEPTH; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "chain %d", i);
+      thread_create (name, PRI_MIN + i, chain_thread, (void *) i);
+      if (thread_get_priority () != PRI_MIN + i)
+        fail ("after chain thread %d, main thread has priority %d",
+              i, thread_get_priority ());
+    }
+  msg ("Main thread got priority %d through %d hops.",
+       thread_get_priority (), DEPTH);
+  lock_release (&chain_locks[0]);
+  if (chain_done != DEPTH)
+    fail ("only %d of %d chain threads finished", chain_done, DEPTH);
+  msg ("Chain unwound, main thread back to priority %d.",
+       thread_get_priority ());
+
+  /* Wide fan-in. */
+  fan_order = malloc (sizeof *fan_order * FAN);
+  if (fan_order == NULL)
+    PANIC ("couldn't allocate memory for test");
+  fan_pos = 0;
+  lock_init (&fan_lock);
+  lock_acquire (&fan_lock);
+  for (i = 0; i < FAN; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "fan %d", i);
+      if (thread_create (name, fan_priority (i), fan_thread, (void *) i)
+          == TID_ERROR)
+        fail ("couldn't create fan thread %d", i);
+    }
+
+  /* Waiters that did not preempt us are still ready to run.  Let
+     all of them block on the lock. */
+  while (heap_size (&fan_lock.waiters) < FAN)
+    timer_sleep (1);
+  msg ("%d threads waiting on one lock.", FAN);
+  msg ("Main thread got priority %d from its waiters.",
+       thread_get_priority ());
+  lock_release (&fan_lock);
+
+  if (fan_pos != FAN)
+    fail ("only %d of %d waiters got the lock", fan_pos, FAN);
+  for (i = 1; i < FAN; i++)
+    {
+      int a = fan_order[i - 1], b = fan_order[i];
+      if (fan_priority (a) < fan_priority (b)
+          || (fan_priority (a) == fan_priority (b) && a > b))
+        fail ("waiter %d (priority %d) got the lock before "
+              "waiter %d (priority %d)",
+              a, fan_priority (a), b, fan_priority (b));
+    }
+  msg ("Waiters got the lock in priority order.");
+  free (fan_order);
+
+  thread_set_priority (PRI_DEFAULT);
+}
+
+static void
+chain_thread (void *id_)
+{
+  int id = (int) id_;
+
+  lock_acquire (&chain_locks[id]);
+  lock_acquire (&chain_locks[id - 1]);
+  lock_release (&chain_locks[id - 1]);
+  lock_release (&chain_locks[id]);
+  chain_done++;
+}
+
+static void
+fan_thread (void *id_)
+{
+  int id = (int) id_;
+
+  lock_acquire (&fan_lock);
+  fan_order[fan_pos++] = id;
+  lock_release (&fan_lock);
+}
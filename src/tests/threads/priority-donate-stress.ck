@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-stress) begin
+(priority-donate-stress) Building a 63-deep donation chain.
+(priority-donate-stress) Main thread got priority 63 through 63 hops.
+(priority-donate-stress) Chain unwound, main thread back to priority 0.
+(priority-donate-stress) 500 threads waiting on one lock.
+(priority-donate-stress) Main thread got priority 63 from its waiters.
+(priority-donate-stress) Waiters got the lock in priority order.
+(priority-donate-stress) end
+EOF
+pass;
@@ -0,0 +1,82 @@
+/* Checks workqueues.  Work queued before a workqueue has workers
+   waits for them, a pending item is not queued twice, and work
+   runs at the priority of the workqueue's workers: below the main
+   thread it waits for the main thread to block, above it it runs
+   as soon as it is queued. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define ITEM_CNT 3
+
+static struct workqueue low_wq, high_wq;
+static struct work items[ITEM_CNT], high_item;
+static struct semaphore done;
+static int ran_cnt;
+static int wrong_priority_cnt;
+
+static work_func low_work;
+static work_func high_work;
+
+void
+test_priority_workqueue (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&done, 0);
+  workqueue_init (&low_wq, "low");
+  workqueue_init (&high_wq, "high");
+
+  for (i = 0; i < ITEM_CNT; i++)
+    {
+      work_init (&items[i], low_work);
+      if (!work_queue (&low_wq, &items[i]))
+        fail ("couldn't queue work item %d", i);
+    }
+  if (work_queue (&low_wq, &items[0]))
+    fail ("pending work item queued twice");
+  msg ("Queued %d work items before starting the workers.", ITEM_CNT);
+
+  workqueue_start (&low_wq, PRI_DEFAULT - 1, 2);
+  if (ran_cnt != 0)
+    fail ("lower priority workers ran before the main thread blocked");
+  for (i = 0; i < ITEM_CNT; i++)
+    sema_down (&done);
+  if (wrong_priority_cnt != 0)
+    fail ("work ran at the wrong priority");
+  msg ("All %d work items ran at priority %d.", ITEM_CNT, PRI_DEFAULT - 1);
+
+  workqueue_start (&high_wq, PRI_DEFAULT + 1, 1);
+  work_init (&high_item, high_work);
+  work_queue (&high_wq, &high_item);
+  msg ("Main thread finished.");
+}
+
+static void
+low_work (struct work *w UNUSED)
+{
+  enum intr_level old_level = intr_disable ();
+  ran_cnt++;
+  if (thread_get_priority () != PRI_DEFAULT - 1)
+    wrong_priority_cnt++;
+  intr_set_level (old_level);
+  sema_up (&done);
+}
+
+static void
+high_work (struct work *w UNUSED)
+{
+  msg ("High priority work should have priority %d.  "
+       "Actual priority: %d.", PRI_DEFAULT + 1, thread_get_priority ());
+}
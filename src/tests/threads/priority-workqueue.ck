@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-workqueue) begin
+(priority-workqueue) Queued 3 work items before starting the workers.
+(priority-workqueue) All 3 work items ran at priority 30.
+(priority-workqueue) High priority work should have priority 32.  Actual priority: 32.
+(priority-workqueue) Main thread finished.
+(priority-workqueue) end
+EOF
+pass;
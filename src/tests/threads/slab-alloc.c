@@ -0,0 +1,147 @@
+/* Compares a slab cache against malloc() for an object whose
+   size, like that of `struct inode', falls just past a power of
+   2.  Holding many of them at once, the cache must use fewer
+   pages than malloc(), and allocating and freeing them must not
+   be slower.  Also checks that a constructor runs once per
+   object, not once per allocation, and that the state it sets up
+   survives being freed and allocated again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "devices/timer.h"
+
+/* Object size: a 512-byte sector plus some bookkeeping. */
+#define OBJ_SIZE 540
+
+/* Number of objects held at once. */
+#define OBJ_CNT 1000
+
+/* Allocate-and-free rounds for the latency measurement. */
+#define ROUND_CNT 200
+
+struct ctor_obj
+  {
+    int magic;
+    char pad[OBJ_SIZE - sizeof (int)];
+  };
+
+#define CTOR_MAGIC 0x12345678
+
+static void *objs[OBJ_CNT];
+static int ctor_cnt;
+
+static size_t kernel_free_pages (void);
+static void ctor (void *);
+
+void
+test_slab_alloc (void)
+{
+  struct kmem_cache *cache, *ctor_cache;
+  size_t before, malloc_pages, slab_pages;
+  int64_t start, malloc_ticks, slab_ticks;
+  int constructed;
+  int i, round;
+
+  cache = kmem_cache_create ("test", OBJ_SIZE, 0, NULL);
+  ctor_cache = kmem_cache_create ("test-ctor", sizeof (struct ctor_obj), 0,
+                                  ctor);
+  if (cache == NULL || ctor_cache == NULL)
+    fail ("couldn't create caches");
+
+  /* Memory used by OBJ_CNT objects at once. */
+  before = kernel_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    if ((objs[i] = malloc (OBJ_SIZE)) == NULL)
+      fail ("malloc failed");
+  malloc_pages = before - kernel_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    free (objs[i]);
+
+  before = kernel_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    if ((objs[i] = kmem_cache_alloc (cache)) == NULL)
+      fail ("kmem_cache_alloc failed");
+  slab_pages = before - kernel_free_pages ();
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+
+  msg ("%d objects of %d bytes: malloc uses %zu pages, slab uses %zu.",
+       OBJ_CNT, OBJ_SIZE, malloc_pages, slab_pages);
+  if (slab_pages >= malloc_pages)
+    fail ("slab cache does not save memory");
+
+  /* Allocation latency. */
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < OBJ_CNT; i++)
+        objs[i] = malloc (OBJ_SIZE);
+      for (i = 0; i < OBJ_CNT; i++)
+        free (objs[i]);
+    }
+  malloc_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < OBJ_CNT; i++)
+        objs[i] = kmem_cache_alloc (cache);
+      for (i = 0; i < OBJ_CNT; i++)
+        kmem_cache_free (cache, objs[i]);
+    }
+  slab_ticks = timer_elapsed (start);
+
+  msg ("%d allocations and frees: malloc %lld ticks, slab %lld ticks.",
+       OBJ_CNT * ROUND_CNT, malloc_ticks, slab_ticks);
+  if (slab_ticks > malloc_ticks + 1)
+    fail ("slab cache is slower than malloc");
+
+  /* Constructed objects.  Freeing every other object leaves no
+     slab empty, so reallocating them must not construct any more
+     objects. */
+  for (i = 0; i < OBJ_CNT; i++)
+    if ((objs[i] = kmem_cache_alloc (ctor_cache)) == NULL)
+      fail ("kmem_cache_alloc failed");
+  constructed = ctor_cnt;
+  for (round = 0; round < 3; round++)
+    {
+      for (i = 0; i < OBJ_CNT; i += 2)
+        kmem_cache_free (ctor_cache, objs[i]);
+      for (i = 0; i < OBJ_CNT; i += 2)
+        {
+          struct ctor_obj *o = objs[i] = kmem_cache_alloc (ctor_cache);
+          if (o == NULL)
+            fail ("kmem_cache_alloc failed");
+          if (o->magic != CTOR_MAGIC)
+            fail ("object not in constructed state");
+        }
+    }
+  if (ctor_cnt != constructed)
+    fail ("constructor ran %d more times on reallocation",
+          ctor_cnt - constructed);
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (ctor_cache, objs[i]);
+  msg ("Constructor ran once per object.");
+  msg ("PASS");
+}
+
+/* Returns the number of free pages in the kernel pool. */
+static size_t
+kernel_free_pages (void)
+{
+  size_t free_cnt, largest;
+  palloc_stats (0, &free_cnt, &largest);
+  return free_cnt;
+}
+
+static void
+ctor (void *o_)
+{
+  struct ctor_obj *o = o_;
+  o->magic = CTOR_MAGIC;
+  ctor_cnt++;
+}
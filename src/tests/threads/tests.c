@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-stress", test_alarm_stress},
+    {"alarm-timeout", test_alarm_timeout},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,6 +27,17 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-stress", test_priority_donate_stress},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
+    {"priority-workqueue", test_priority_workqueue},
+    {"thread-spawn", test_thread_spawn},
+    {"palloc-buddy", test_palloc_buddy},
+    {"slab-alloc", test_slab_alloc},
+    {"palloc-zero", test_palloc_zero},
+    {"kernel-tlb", test_kernel_tlb},
+    {"bitmap-scan", test_bitmap_scan},
+    {"vmalloc-frag", test_vmalloc_frag},
+    {"palloc-shrink", test_palloc_shrink},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
@@ -38,6 +51,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-tick-cost", test_mlfqs_tick_cost},
   };
 
 static const char *test_name;
@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_stress;
+extern test_func test_alarm_timeout;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,6 +21,17 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_stress;
+extern test_func test_priority_donate_rwlock;
+extern test_func test_priority_workqueue;
+extern test_func test_thread_spawn;
+extern test_func test_palloc_buddy;
+extern test_func test_slab_alloc;
+extern test_func test_palloc_zero;
+extern test_func test_kernel_tlb;
+extern test_func test_bitmap_scan;
+extern test_func test_vmalloc_frag;
+extern test_func test_palloc_shrink;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
@@ -32,6 +45,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_tick_cost;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,46 @@
+/* Measures thread creation throughput.  Creates short-lived
+   threads one after another, each of which runs and exits before
+   the next is created, the way helper threads are used.  Nearly
+   every one of them should get its page from the thread page
+   cache. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPAWN_CNT 10000
+
+static thread_func helper;
+static int helper_cnt;
+
+void
+test_thread_spawn (void)
+{
+  int64_t start, elapsed, hits;
+  int i;
+
+  hits = thread_cache_hit_cnt ();
+  start = timer_ticks ();
+  for (i = 0; i < SPAWN_CNT; i++)
+    if (thread_create ("helper", PRI_MAX, helper, NULL) == TID_ERROR)
+      fail ("couldn't create helper %d", i);
+  elapsed = timer_elapsed (start);
+  hits = thread_cache_hit_cnt () - hits;
+
+  if (helper_cnt != SPAWN_CNT)
+    fail ("only %d of %d helpers ran", helper_cnt, SPAWN_CNT);
+  msg ("Spawned %d threads in %lld ticks, %lld threads per second.",
+       SPAWN_CNT, elapsed, SPAWN_CNT * TIMER_FREQ / (elapsed + 1));
+  msg ("%lld of %d thread pages came from the cache.", hits, SPAWN_CNT);
+  if (hits < SPAWN_CNT - SPAWN_CNT / 10)
+    fail ("thread page cache hit rate too low");
+  msg ("PASS");
+}
+
+static void
+helper (void *aux UNUSED)
+{
+  helper_cnt++;
+}
@@ -0,0 +1,81 @@
+/* Fragments the kernel pool so that no two free pages are
+   adjacent, then checks that a large malloc() still succeeds,
+   through vmalloc(), and that its memory is usable and comes
+   back when freed. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+#define BUF_SIZE (64 * 1024)
+
+void
+test_vmalloc_frag (void)
+{
+  void *held = NULL;
+  void **link;
+  void *page;
+  size_t held_cnt = 0, free_cnt, free_after, largest;
+  uint8_t *buf;
+  size_t i;
+
+  /* Take every kernel page, chaining them through their first
+     words.  Then give back the odd-numbered ones, so that no two
+     free pages are adjacent. */
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = held;
+      held = page;
+      held_cnt++;
+    }
+  for (link = &held; *link != NULL; )
+    {
+      page = *link;
+      if (pg_no (page) % 2 == 1)
+        {
+          *link = *(void **) page;
+          palloc_free_page (page);
+        }
+      else
+        link = page;
+    }
+
+  palloc_stats (0, &free_cnt, &largest);
+  msg ("Took %zu pages and gave back the odd-numbered ones.", held_cnt);
+  if (largest > 1)
+    fail ("largest free block is %zu pages, expected 1", largest);
+  if (palloc_get_multiple (0, 2) != NULL)
+    fail ("got 2 contiguous pages from a fragmented pool");
+
+  buf = malloc (BUF_SIZE);
+  if (buf == NULL)
+    fail ("malloc (%d) failed with %zu pages free", BUF_SIZE, free_cnt);
+  if (!is_vmalloc_addr (buf))
+    fail ("malloc (%d) did not use vmalloc", BUF_SIZE);
+  msg ("malloc (%d) succeeded with only single free pages.", BUF_SIZE);
+
+  for (i = 0; i < BUF_SIZE; i++)
+    buf[i] = i % 251;
+  for (i = 0; i < BUF_SIZE; i++)
+    if (buf[i] != i % 251)
+      fail ("byte %zu of buffer reads back %d", i, buf[i]);
+  free (buf);
+
+  palloc_stats (0, &free_after, &largest);
+  if (free_after != free_cnt)
+    fail ("%zu pages free after free(), expected %zu", free_after, free_cnt);
+  msg ("Buffer was usable and its pages came back.");
+
+  while (held != NULL)
+    {
+      page = held;
+      held = *(void **) page;
+      palloc_free_page (page);
+    }
+  msg ("PASS");
+}
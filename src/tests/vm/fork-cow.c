@@ -0,0 +1,52 @@
+/* Forks a child that overwrites a buffer its parent filled
+   before the fork, and verifies that the parent's copy of the
+   buffer is unchanged and that the child saw the parent's data
+   until it wrote its own. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+/* Fails unless every byte of BUF is VALUE. */
+static void
+check_buf (char value, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      fail ("%s: byte %zu is %#x, not %#x", who, i, buf[i], value);
+}
+
+void
+test_main (void)
+{
+  pid_t pid;
+  int status;
+
+  memset (buf, 0x5a, sizeof buf);
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      check_buf (0x5a, "child");
+      msg ("child: rewrite buffer");
+      memset (buf, 0xa5, sizeof buf);
+      check_buf (0xa5, "child");
+      exit (42);
+    }
+
+  /* Print nothing until the child is done, so that the output
+     doesn't depend on how the two are scheduled. */
+  status = wait (pid);
+  CHECK (pid != -1, "parent: fork returned a pid");
+  CHECK (status == 42, "parent: wait for child");
+  check_buf (0x5a, "parent");
+  msg ("parent: buffer unchanged");
+}
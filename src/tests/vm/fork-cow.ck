@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) fork
+(fork-cow) child: rewrite buffer
+fork-cow: exit(42)
+(fork-cow) parent: fork returned a pid
+(fork-cow) parent: wait for child
+(fork-cow) parent: buffer unchanged
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
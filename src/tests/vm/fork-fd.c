@@ -0,0 +1,46 @@
+/* Opens a file and reads part of it, then forks a child that
+   reads on from the same handle, and verifies that the child got
+   the next bytes of the file and that its reads did not move the
+   parent's position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 16
+
+void
+test_main (void)
+{
+  char buf[CHUNK];
+  int handle;
+  pid_t pid;
+  int status;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (read (handle, buf, CHUNK) == CHUNK, "read \"sample.txt\"");
+
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      if (tell (handle) != CHUNK)
+        fail ("child: position is %u, not %d", tell (handle), CHUNK);
+      if (read (handle, buf, CHUNK) != CHUNK)
+        fail ("child: read failed");
+      if (memcmp (buf, sample + CHUNK, CHUNK))
+        fail ("child: read wrong data");
+      msg ("child: read on from parent's position");
+      exit (42);
+    }
+
+  /* Print nothing until the child is done, so that the output
+     doesn't depend on how the two are scheduled. */
+  status = wait (pid);
+  CHECK (pid != -1, "parent: fork returned a pid");
+  CHECK (status == 42, "parent: wait for child");
+  CHECK (tell (handle) == CHUNK, "parent: position unchanged");
+  close (handle);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-fd) begin
+(fork-fd) open "sample.txt"
+(fork-fd) read "sample.txt"
+(fork-fd) fork
+(fork-fd) child: read on from parent's position
+fork-fd: exit(42)
+(fork-fd) parent: fork returned a pid
+(fork-fd) parent: wait for child
+(fork-fd) parent: position unchanged
+(fork-fd) end
+fork-fd: exit(0)
+EOF
+pass;
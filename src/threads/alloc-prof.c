@@ -0,0 +1,172 @@
+#include "threads/alloc-prof.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Allocation profiling.
+
+   With -alloc-prof, each malloc() and palloc allocation is
+   charged to its call site, the return address of the call into
+   the allocator, and each free is charged back to the site that
+   made the allocation.  Per site we keep the bytes currently
+   live, the most ever live at once, and the number of
+   allocations and frees.  The allocators remember each block's
+   site: malloc() in a small header in front of the block,
+   palloc in a table with an entry per page.
+
+   The "alloc-report" action prints the sites sorted by live
+   bytes, followed by malloc()'s per-size utilization and the
+   slab caches.  Sites are code addresses; to turn them into
+   function names and line numbers, pass them to the `backtrace'
+   utility along with kernel.o.
+
+   Pages that back malloc() arenas and slabs show up as palloc
+   sites in malloc.c and slab.c, so live bytes for those sites
+   overlap the malloc() sites and caches they serve. */
+
+/* If true, account allocations to their call sites.
+   Controlled by kernel command-line option "-alloc-prof". */
+bool alloc_prof_enabled;
+
+/* Number of call sites tracked.  Index 0 collects allocations
+   from sites that don't fit. */
+#define SITE_CNT 512
+
+/* Allocations made at one call site. */
+struct alloc_site
+  {
+    const void *site;           /* Return address into caller. */
+    enum alloc_kind kind;       /* Allocator called. */
+    size_t live;                /* Bytes allocated and not freed. */
+    size_t peak;                /* Maximum of LIVE. */
+    unsigned alloc_cnt;         /* Number of allocations. */
+    unsigned free_cnt;          /* Number of frees. */
+  };
+
+static struct alloc_site sites[SITE_CNT];
+
+static int compare_live (const void *, const void *);
+
+/* Records an allocation of BYTES bytes by the given allocator
+   KIND from call site SITE.  Returns an index that the allocator
+   must pass to alloc_prof_free() when the memory is freed.  May
+   be called with interrupts off. */
+unsigned
+alloc_prof_alloc (enum alloc_kind kind, const void *site, size_t bytes)
+{
+  enum intr_level old_level;
+  struct alloc_site *s;
+  unsigned idx, i;
+
+  old_level = intr_disable ();
+
+  /* Open addressing with linear probing, skipping index 0. */
+  idx = 0;
+  for (i = 0; i < SITE_CNT - 1; i++)
+    {
+      unsigned probe = ((uintptr_t) site + kind + i) % (SITE_CNT - 1) + 1;
+      s = &sites[probe];
+      if (s->site == NULL)
+        {
+          s->site = site;
+          s->kind = kind;
+        }
+      if (s->site == site && s->kind == kind)
+        {
+          idx = probe;
+          break;
+        }
+    }
+
+  s = &sites[idx];
+  s->live += bytes;
+  if (s->live > s->peak)
+    s->peak = s->live;
+  s->alloc_cnt++;
+  intr_set_level (old_level);
+
+  return idx;
+}
+
+/* Records that BYTES bytes allocated at the site with index
+   SITE_IDX were freed.  May be called with interrupts off. */
+void
+alloc_prof_free (unsigned site_idx, size_t bytes)
+{
+  enum intr_level old_level;
+  struct alloc_site *s;
+
+  ASSERT (site_idx < SITE_CNT);
+
+  old_level = intr_disable ();
+  s = &sites[site_idx];
+  ASSERT (s->live >= bytes);
+  s->live -= bytes;
+  s->free_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Prints the allocation profile, sorted by live bytes, and the
+   state of malloc() and the slab caches. */
+void
+alloc_prof_report (char **argv UNUSED)
+{
+  static struct alloc_site sorted[SITE_CNT];
+  enum intr_level old_level;
+  size_t sorted_cnt = 0;
+  size_t live = 0;
+  size_t i;
+
+  if (!alloc_prof_enabled)
+    printf ("Allocation profiling is off; boot with -alloc-prof.\n");
+  else
+    {
+      /* Take a snapshot, so that printing doesn't change it. */
+      old_level = intr_disable ();
+      for (i = 0; i < SITE_CNT; i++)
+        if (sites[i].alloc_cnt > 0)
+          sorted[sorted_cnt++] = sites[i];
+      intr_set_level (old_level);
+      qsort (sorted, sorted_cnt, sizeof *sorted, compare_live);
+
+      printf ("Call site   Allocator        Live       Peak     Allocs      Frees\n");
+      for (i = 0; i < sorted_cnt; i++)
+        {
+          struct alloc_site *s = &sorted[i];
+          if (s->site != NULL)
+            printf ("%10p", s->site);
+          else
+            printf ("%10s", "(other)");
+          printf ("  %-9s %10zu %10zu %10u %10u\n",
+                  s->site == NULL ? "-"
+                  : s->kind == ALLOC_MALLOC ? "malloc" : "palloc",
+                  s->live, s->peak, s->alloc_cnt, s->free_cnt);
+          live += s->live;
+        }
+      printf ("%zu call sites, %zu bytes live.\n", sorted_cnt, live);
+      printf ("Translate call sites with `backtrace kernel.o ADDR...'.\n");
+    }
+
+  malloc_print_stats ();
+  kmem_print_stats ();
+}
+
+/* qsort() comparison function that orders sites by descending
+   live bytes, then by descending peak. */
+static int
+compare_live (const void *a_, const void *b_)
+{
+  const struct alloc_site *a = a_;
+  const struct alloc_site *b = b_;
+
+  if (a->live != b->live)
+    return a->live < b->live ? 1 : -1;
+  if (a->peak != b->peak)
+    return a->peak < b->peak ? 1 : -1;
+  return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef THREADS_ALLOC_PROF_H
+#define THREADS_ALLOC_PROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Allocators whose call sites are profiled. */
+enum alloc_kind
+  {
+    ALLOC_MALLOC,               /* malloc(), calloc(), realloc(). */
+    ALLOC_PALLOC                /* palloc_get_page(), palloc_get_multiple(). */
+  };
+
+/* If true, account allocations to their call sites.
+   Controlled by kernel command-line option "-alloc-prof". */
+extern bool alloc_prof_enabled;
+
+unsigned alloc_prof_alloc (enum alloc_kind, const void *site, size_t bytes);
+void alloc_prof_free (unsigned site_idx, size_t bytes);
+void alloc_prof_report (char **argv);
+
+#endif /* threads/alloc-prof.h */
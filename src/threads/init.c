@@ -15,13 +15,17 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/alloc-prof.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -37,10 +41,21 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* Number of 4 MB pages in its mapping of physical memory. */
+size_t init_large_page_cnt;
+
+/* -no-pse: Map physical memory with 4 kB pages only? */
+static bool no_large_pages;
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -59,6 +74,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -98,6 +114,8 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
+  sched_trace_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -105,7 +123,9 @@ main (void)
   gdt_init ();
 #endif
 
-  /* Initialize interrupt handlers. */
+  /* Initialize interrupt handlers and the workqueue they defer
+     work to. */
+  workqueue_init (&system_wq, "kworker");
   intr_init ();
   timer_init ();
   kbd_init ();
@@ -117,6 +137,7 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_start (&system_wq, PRI_MAX, 1);
   serial_init_queue ();
   timer_calibrate ();
 
@@ -127,6 +148,12 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -150,15 +177,29 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CR4 bit that enables 4 MB pages. */
+#define CR4_PSE 0x00000010
+
+/* CPUID.1:EDX bit that says 4 MB pages are supported. */
+#define CPUID_PSE 0x00000008
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB of physical memory that lies
+   entirely within RAM and holds no kernel code is mapped with a
+   single 4 MB page.  That saves a page table per 4 MB and lets
+   one TLB entry cover what would otherwise take 1,024.  The rest
+   is mapped with 4 kB pages, so that kernel code can still be
+   made read-only. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  bool large = !no_large_pages && cpu_has_pse ();
   extern char _start, _end_kernel_text;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -171,6 +212,16 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true);
+          init_large_page_cnt++;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -180,6 +231,16 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* 4 MB pages must be enabled before the page directory that
+     uses them is loaded.  See [IA32-v3a] 2.5 "Control
+     Registers". */
+  if (init_large_page_cnt > 0)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -188,6 +249,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages.  See [IA32-v2a]
+   "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -251,11 +323,23 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-eager-load"))
+        page_eager_load = true;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_enabled = true;
+      else if (!strcmp (name, "-alloc-prof"))
+        alloc_prof_enabled = true;
+      else if (!strcmp (name, "-no-pse"))
+        no_large_pages = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -309,12 +393,17 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"alloc-report", 1, alloc_prof_report},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"dump-sched-trace", 1, sched_trace_dump},
+#endif
+#ifdef VM
+      {"exec-bench", 2, process_exec_bench},
 #endif
       {NULL, 0, NULL},
     };
@@ -357,13 +446,18 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  alloc-report       Print memory use by -alloc-prof call site.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  dump-sched-trace   Write the -sched-trace record to scratch device.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+#endif
+#ifdef VM
+          "  exec-bench PROG    Time loading PROG eagerly and on demand.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -379,8 +473,15 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer tick while idle.\n"
+          "  -sched-trace       Record context switches for dump-sched-trace.\n"
+          "  -alloc-prof        Account allocations to call sites for alloc-report.\n"
+          "  -no-pse            Map physical memory with 4 kB pages only.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -eager-load        Read whole executables at exec time.\n"
 #endif
           );
   shutdown_power_off ();
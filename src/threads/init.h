@@ -9,4 +9,7 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* Number of 4 MB pages in its mapping of physical memory. */
+extern size_t init_large_page_cnt;
+
 #endif /* threads/init.h */
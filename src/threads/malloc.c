@@ -5,9 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/alloc-prof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +34,15 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   page allocator has no run of free pages that long, we use
+   vmalloc() instead, which needs only as many free pages,
+   wherever they are.
+
+   When allocation profiling is on, each block is allocated with
+   room for a profile header in front of it that records the
+   call site and the requested size, for free() to charge the
+   block back to. */
 
 /* Descriptor. */
 struct desc
@@ -40,6 +50,7 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t arena_cnt;           /* Number of arenas. */
     struct lock lock;           /* Lock. */
   };
 
@@ -60,12 +71,23 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Profile header, in front of each block handed out while
+   allocation profiling is on. */
+struct prof_header
+  {
+    size_t size;                /* Requested size in bytes. */
+    unsigned site_idx;          /* From alloc_prof_alloc(). */
+  };
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_at (size_t size, const void *site);
+static void *allocate (size_t size);
+static void release (void *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,6 +102,7 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->arena_cnt = 0;
       lock_init (&d->lock);
     }
 }
@@ -89,14 +112,42 @@ malloc_init (void)
 void *
 malloc (size_t size) 
 {
-  struct desc *d;
-  struct block *b;
-  struct arena *a;
+  return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, for
+   call site SITE.  Returns a null pointer if memory is not
+   available. */
+static void *
+malloc_at (size_t size, const void *site)
+{
+  struct prof_header *h;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
 
+  if (!alloc_prof_enabled)
+    return allocate (size);
+
+  h = allocate (sizeof *h + size);
+  if (h == NULL)
+    return NULL;
+  h->size = size;
+  h->site_idx = alloc_prof_alloc (ALLOC_MALLOC, site, size);
+  return h + 1;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, which
+   must be nonzero.  Returns a null pointer if memory is not
+   available. */
+static void *
+allocate (size_t size) 
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
   for (d = descs; d < descs + desc_cnt; d++)
@@ -108,6 +159,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL)
+        a = vmalloc (page_cnt * PGSIZE);
       if (a == NULL)
         return NULL;
 
@@ -135,6 +188,7 @@ malloc (size_t size)
         }
 
       /* Initialize arena and add its blocks to the free list. */
+      d->arena_cnt++;
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
@@ -167,7 +221,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_at (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -179,9 +233,14 @@ static size_t
 block_size (void *block) 
 {
   struct block *b = block;
-  struct arena *a = block_to_arena (b);
-  struct desc *d = a->desc;
+  struct arena *a;
+  struct desc *d;
 
+  if (alloc_prof_enabled)
+    return ((struct prof_header *) block - 1)->size;
+
+  a = block_to_arena (b);
+  d = a->desc;
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
@@ -201,7 +260,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_at (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -217,6 +276,43 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+  if (p != NULL && alloc_prof_enabled)
+    {
+      struct prof_header *h = (struct prof_header *) p - 1;
+      alloc_prof_free (h->site_idx, h->size);
+      p = h;
+    }
+  release (p);
+}
+
+/* Prints, for each block size, how many arenas there are and how
+   many of their blocks are in use. */
+void
+malloc_print_stats (void)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      size_t arena_cnt, block_cnt, free_cnt;
+
+      lock_acquire (&d->lock);
+      arena_cnt = d->arena_cnt;
+      free_cnt = list_size (&d->free_list);
+      lock_release (&d->lock);
+
+      block_cnt = arena_cnt * d->blocks_per_arena;
+      printf ("Malloc: %4zu-byte blocks: %zu arenas, "
+              "%zu of %zu blocks in use (%zu%%)\n",
+              d->block_size, arena_cnt, block_cnt - free_cnt, block_cnt,
+              block_cnt > 0 ? (block_cnt - free_cnt) * 100 / block_cnt : 0);
+    }
+}
+
+/* Frees block P, which must have been allocated with allocate(). */
+static void
+release (void *p)
 {
   if (p != NULL)
     {
@@ -249,6 +345,7 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
+              d->arena_cnt--;
               palloc_free_page (a);
             }
 
@@ -257,7 +354,10 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_addr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
@@ -2,11 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/alloc-prof.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,22 +26,85 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, aligned to their size
+   relative to the pool base, on one free list per order.  A
+   request is served from the smallest block big enough, split
+   in halves as needed, and the unneeded tail is given back right
+   away, so exactly the requested pages are used.  A freed block
+   merges with its buddy, the other half of the block they were
+   split from, whenever that is free too.  Allocation and freeing
+   are O(log n) in the pool size.
+
+   Pages may be freed with interrupts off, for example by
+   thread_schedule_tail(), so the pools are protected by turning
+   interrupts off rather than by a lock.
+
+   When a pool runs dry, the page allocator asks the shrinkers
+   that subsystems have registered with shrinker_register(), in
+   order of priority, to give back memory they are only holding
+   on to as a cache, and tries again after each one that does.
+
+   Besides its free blocks, each pool keeps a small stock of free
+   pages that are already zeroed, filled by the idle thread
+   through palloc_zero_idle().  A single-page PAL_ZERO request is
+   served from that stock when it can be, without a memset on the
+   caller's path.  The stock is given back to the buddy system if
+   a request cannot be met otherwise. */
+
+/* Highest block order, enough for 4 GB of pages. */
+#define MAX_ORDER 20
+
+/* Maximum number of pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 64
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *used_map;            /* Bitmap of used pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    size_t free_cnt;                    /* Number of free pages. */
+    uint8_t *free_order;                /* For each page, 1 + order of the free
+                                           block it starts, or 0. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks, by order. */
+    void *zeroed[ZEROED_MAX];           /* Free pages already zeroed. */
+    size_t zeroed_cnt;                  /* Number of pages in zeroed. */
+    long long zero_hits;                /* PAL_ZERO pages from zeroed. */
+    long long zero_misses;              /* PAL_ZERO pages zeroed on demand. */
+    uint16_t *site_map;                 /* With -alloc-prof, for the first
+                                           page of each allocation, its
+                                           site's index. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Registered shrinkers, highest priority first. */
+static struct list shrinkers = LIST_INITIALIZER (shrinkers);
+
+/* Held while the shrinkers run.  Allocations that fail while
+   another thread holds it wait for it and then retry, and
+   allocations made by the shrinkers themselves, whose thread
+   already holds it, fail without running them again. */
+static struct lock shrink_lock;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void *get_multiple (enum palloc_flags, size_t page_cnt,
+                           const void *site);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static size_t shrink_and_alloc (struct pool *, enum palloc_flags,
+                                size_t page_cnt);
+static void release_zeroed (struct pool *);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static size_t buddy_alloc_range (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free_block (struct pool *, size_t page_idx, int order);
+static void buddy_remove_block (struct pool *, size_t page_idx, int order);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -55,6 +121,8 @@ palloc_init (size_t user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
 
+  lock_init (&shrink_lock);
+
   /* Give half of memory to kernel, half to user. */
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
@@ -70,34 +138,7 @@ palloc_init (size_t user_page_limit)
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
-  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
-  size_t page_idx;
-
-  if (page_cnt == 0)
-    return NULL;
-
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
-
-  if (pages != NULL) 
-    {
-      if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
-    }
-  else 
-    {
-      if (flags & PAL_ASSERT)
-        PANIC ("palloc_get: out of pages");
-    }
-
-  return pages;
+  return get_multiple (flags, page_cnt, __builtin_return_address (0));
 }
 
 /* Obtains a single free page and returns its kernel virtual
@@ -110,7 +151,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  return get_multiple (flags, 1, __builtin_return_address (0));
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -119,6 +160,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +179,13 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  if (pool->site_map != NULL)
+    alloc_prof_free (pool->site_map[page_idx], page_cnt * PGSIZE);
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +195,498 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Obtains and returns a group of PAGE_CNT contiguous free pages,
+   as palloc_get_multiple(), for call site SITE. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt, const void *site)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  void *pages;
+  size_t page_idx;
+  bool zeroed = false;
+  enum intr_level old_level;
+
+  if (page_cnt == 0)
+    return NULL;
+
+  old_level = intr_disable ();
+  if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0)
+    {
+      /* Already zeroed by the idle thread. */
+      uint8_t *page = pool->zeroed[--pool->zeroed_cnt];
+      page_idx = (page - pool->base) / PGSIZE;
+      pool->zero_hits++;
+      zeroed = true;
+    }
+  else
+    {
+      if ((flags & PAL_ZERO) && page_cnt == 1)
+        pool->zero_misses++;
+      page_idx = alloc_pages (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+        {
+          release_zeroed (pool);
+          page_idx = alloc_pages (pool, page_cnt);
+        }
+    }
+  intr_set_level (old_level);
+
+  if (page_idx == BITMAP_ERROR)
+    page_idx = shrink_and_alloc (pool, flags, page_cnt);
+  if (page_idx != BITMAP_ERROR && pool->site_map != NULL)
+    {
+      old_level = intr_disable ();
+      pool->site_map[page_idx] = alloc_prof_alloc (ALLOC_PALLOC, site,
+                                                   page_cnt * PGSIZE);
+      intr_set_level (old_level);
+    }
+
+  if (page_idx != BITMAP_ERROR)
+    pages = pool->base + PGSIZE * page_idx;
+  else
+    pages = NULL;
+
+  if (pages != NULL) 
+    {
+      if ((flags & PAL_ZERO) && !zeroed)
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  else 
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get: out of pages");
+    }
+
+  return pages;
+}
+
+/* Registers shrinker S, which must stay valid until it is passed
+   to shrinker_unregister().  Its shrink function is called when an allocation
+   from either pool is about to fail, to release memory that its
+   owner can do without.  It is passed PAL_USER or 0 to say which
+   pool is short and how many pages are wanted, and returns the
+   number of pages it released from that pool.
+
+   Shrinkers run in the allocating thread, which may hold any
+   locks, and may be called from any code that allocates pages,
+   so they must never block: they should skip any lock that the
+   current thread holds, take the others with lock_try_acquire(),
+   and skip anything that is busy.  Shrinkers
+   with higher PRIORITY run first, so cheap-to-rebuild caches
+   should have high priority. */
+void
+shrinker_register (struct shrinker *s)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  ASSERT (s != NULL && s->shrink != NULL);
+
+  s->call_cnt = 0;
+  s->released_cnt = 0;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    if (list_entry (e, struct shrinker, elem)->priority < s->priority)
+      break;
+  list_insert (e, &s->elem);
+  intr_set_level (old_level);
+}
+
+/* Unregisters shrinker S, which must have been registered with
+   shrinker_register().  Waits for any shrinker pass underway to
+   finish, so S is not running once this returns.  Must not be
+   called by a shrinker. */
+void
+shrinker_unregister (struct shrinker *s)
+{
+  enum intr_level old_level;
+
+  ASSERT (s != NULL);
+
+  lock_acquire (&shrink_lock);
+  old_level = intr_disable ();
+  list_remove (&s->elem);
+  intr_set_level (old_level);
+  lock_release (&shrink_lock);
+}
+
+/* Prints how many pages each shrinker released. */
+void
+shrinker_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf ("Shrinker %s: %u calls, %zu pages released\n",
+              s->name, s->call_cnt, s->released_cnt);
+    }
+}
+
+/* Zeroes one free page and adds it to its pool's stock of
+   pre-zeroed pages, preferring the kernel pool.  Called by the
+   idle thread with interrupts on.  Returns false if there is
+   nothing left to do, because every stock is full or there are
+   no free pages to zero. */
+bool
+palloc_zero_idle (void)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  struct pool *pool = NULL;
+  enum intr_level old_level;
+  size_t page_idx = BITMAP_ERROR;
+  void *page;
+  size_t i;
+
+  old_level = intr_disable ();
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    if (pools[i]->zeroed_cnt < ZEROED_MAX)
+      {
+        page_idx = buddy_alloc (pools[i], 1);
+        if (page_idx != BITMAP_ERROR)
+          {
+            pool = pools[i];
+            bitmap_mark (pool->used_map, page_idx);
+            break;
+          }
+      }
+  intr_set_level (old_level);
+  if (pool == NULL)
+    return false;
+
+  /* The page belongs to no one, so it can be zeroed with
+     interrupts on. */
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+
+  old_level = intr_disable ();
+  if (pool->zeroed_cnt < ZEROED_MAX)
+    pool->zeroed[pool->zeroed_cnt++] = page;
+  else
+    {
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Stores the number of single-page PAL_ZERO requests that were
+   served from the pre-zeroed stocks into *HITS, and the number
+   that had to be zeroed on demand into *MISSES. */
+void
+palloc_zero_stats (long long *hits, long long *misses)
+{
+  enum intr_level old_level = intr_disable ();
+  *hits = kernel_pool.zero_hits + user_pool.zero_hits;
+  *misses = kernel_pool.zero_misses + user_pool.zero_misses;
+  intr_set_level (old_level);
+}
+
+/* Stores the number of free pages in the pool selected by FLAGS
+   into *FREE_CNT, and the number of pages in its largest free
+   buddy block into *LARGEST.  A request for more than *LARGEST
+   pages may still succeed, but only by the slow path that looks
+   for any run of free pages. */
+void
+palloc_stats (enum palloc_flags flags, size_t *free_cnt, size_t *largest)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  int order;
+
+  old_level = intr_disable ();
+  *free_cnt = pool->free_cnt + pool->zeroed_cnt;
+  *largest = 0;
+  for (order = MAX_ORDER; order >= 0; order--)
+    if (!list_empty (&pool->free_lists[order]))
+      {
+        *largest = (size_t) 1 << order;
+        break;
+      }
+  intr_set_level (old_level);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map, free_order, and site_map if
+     profiling, at its base.  Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
+  size_t bm_bytes = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (long));
+  size_t order_bytes = ROUND_UP (page_cnt, sizeof (uint16_t));
+  size_t site_bytes = alloc_prof_enabled ? page_cnt * sizeof (uint16_t) : 0;
+  size_t meta_pages = DIV_ROUND_UP (bm_bytes + order_bytes + site_bytes,
+                                    PGSIZE);
+  int order;
+
+  if (meta_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  page_cnt -= meta_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_bytes);
+  p->base = base + meta_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = 0;
+  p->zeroed_cnt = 0;
+  p->zero_hits = p->zero_misses = 0;
+  p->free_order = (uint8_t *) base + bm_bytes;
+  memset (p->free_order, 0, page_cnt);
+  p->site_map = (alloc_prof_enabled
+                 ? (uint16_t *) (p->free_order + order_bytes) : NULL);
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
+
+  /* All of it starts out free. */
+  buddy_free (p, 0, page_cnt);
+}
+
+/* Takes PAGE_CNT pages from POOL and marks them used.  Returns
+   the index of the first page, or BITMAP_ERROR if there are not
+   enough contiguous free pages.  Interrupts must be off. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR)
+    page_idx = buddy_alloc_range (pool, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return page_idx;
+}
+
+/* Runs the shrinkers for POOL, which couldn't supply PAGE_CNT
+   pages for an allocation with the given FLAGS, retrying the
+   allocation after each shrinker that released something.
+   Returns the index of the first page allocated, or BITMAP_ERROR
+   if it still failed.  Shrinkers are not run in an interrupt
+   handler, or by an allocation that a shrinker itself made.  If
+   another thread is running them, waits for it to finish and
+   retries the allocation before running them again. */
+static size_t
+shrink_and_alloc (struct pool *pool, enum palloc_flags flags,
+                  size_t page_cnt)
+{
+  enum palloc_flags pool_flag = flags & PAL_USER;
+  size_t page_idx = BITMAP_ERROR;
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  if (intr_context () || lock_held_by_current_thread (&shrink_lock))
+    return BITMAP_ERROR;
+  lock_acquire (&shrink_lock);
+
+  /* Another thread's shrinker pass may have freed enough. */
+  old_level = intr_disable ();
+  page_idx = alloc_pages (pool, page_cnt);
+  intr_set_level (old_level);
+  if (page_idx != BITMAP_ERROR)
+    {
+      lock_release (&shrink_lock);
+      return page_idx;
+    }
+
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      size_t released = s->shrink (pool_flag, page_cnt);
+
+      old_level = intr_disable ();
+      s->call_cnt++;
+      s->released_cnt += released;
+      if (released > 0)
+        page_idx = alloc_pages (pool, page_cnt);
+      intr_set_level (old_level);
+      if (page_idx != BITMAP_ERROR)
+        break;
+    }
+
+  lock_release (&shrink_lock);
+  return page_idx;
+}
+
+/* Gives all of POOL's pre-zeroed pages back to its free blocks.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->zeroed_cnt > 0)
+    {
+      uint8_t *page = pool->zeroed[--pool->zeroed_cnt];
+      size_t page_idx = (page - pool->base) / PGSIZE;
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+}
+
+/* Returns the free list element kept in the first page of the
+   free block at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Takes PAGE_CNT pages from POOL's free lists, using the
+   smallest free block that is big enough.  Returns the index of
+   the first page, or BITMAP_ERROR if no free block is big
+   enough.  Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int want = order_for (page_cnt);
+  int order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (want > MAX_ORDER)
+    return BITMAP_ERROR;
+  for (order = want; order <= MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  page_idx = ((uint8_t *) list_front (&pool->free_lists[order]) - pool->base)
+             / PGSIZE;
+  buddy_remove_block (pool, page_idx, order);
+
+  /* Give back the halves we don't need, then the tail of the
+     block past PAGE_CNT. */
+  while (order > want)
+    {
+      order--;
+      buddy_free_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+  if (page_cnt < ((size_t) 1 << want))
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/* Takes PAGE_CNT pages from POOL from the first run of free pages
+   long enough, even though no single free block is.  This is the
+   slow path for requests bigger than the largest free block, and
+   takes time linear in the pool size.  Returns the index of the
+   first page, or BITMAP_ERROR if there is no such run.
+   Interrupts must be off. */
+static size_t
+buddy_alloc_range (struct pool *pool, size_t page_cnt)
+{
+  size_t start = bitmap_scan (pool->used_map, 0, page_cnt, false);
+  size_t end = start + page_cnt;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (start == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  /* Take every free block overlapping the run, and give back the
+     parts of them that stick out of it. */
+  for (page_idx = start; page_idx < end; )
+    {
+      size_t block_idx = page_idx;
+      int order;
+
+      for (order = 0; order <= MAX_ORDER; order++)
+        {
+          block_idx = page_idx & ~(((size_t) 1 << order) - 1);
+          if (pool->free_order[block_idx] == order + 1
+              && block_idx + ((size_t) 1 << order) > page_idx)
+            break;
+        }
+      ASSERT (order <= MAX_ORDER);
+
+      buddy_remove_block (pool, block_idx, order);
+      if (block_idx < start)
+        buddy_free (pool, block_idx, start - block_idx);
+      page_idx = block_idx + ((size_t) 1 << order);
+      if (page_idx > end)
+        buddy_free (pool, end, page_idx - end);
+    }
+  return start;
+}
+
+/* Gives the PAGE_CNT pages starting at PAGE_IDX back to POOL, as
+   the biggest aligned blocks they can be split into.
+   Interrupts must be off. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < MAX_ORDER
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      buddy_free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Puts the free block of 2**ORDER pages at PAGE_IDX on POOL's free
+   lists, first merging it with its buddy for as long as the buddy
+   is free too.  Interrupts must be off. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  pool->free_cnt += (size_t) 1 << order;
+  while (order < MAX_ORDER)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+          || pool->free_order[buddy_idx] != order + 1)
+        break;
+
+      buddy_remove_block (pool, buddy_idx, order);
+      pool->free_cnt += (size_t) 1 << order;
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Takes the free block of 2**ORDER pages at PAGE_IDX off POOL's
+   free lists.  Interrupts must be off. */
+static void
+buddy_remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->free_order[page_idx] == order + 1);
+
+  pool->free_order[page_idx] = 0;
+  list_remove (block_elem (pool, page_idx));
+  pool->free_cnt -= (size_t) 1 << order;
 }
 
 /* Returns true if PAGE was allocated from POOL,
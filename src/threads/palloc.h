@@ -1,6 +1,8 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,10 +13,28 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* A shrinker: a callback that releases cached memory when the
+   page allocator runs out.  See shrinker_register(). */
+struct shrinker
+  {
+    const char *name;           /* Name, for statistics. */
+    int priority;               /* Higher priorities are called first. */
+    size_t (*shrink) (enum palloc_flags pool, size_t page_cnt);
+    unsigned call_cnt;          /* Number of times called. */
+    size_t released_cnt;        /* Pages released in all calls. */
+    struct list_elem elem;      /* Element in list of shrinkers. */
+  };
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_stats (enum palloc_flags, size_t *free_cnt, size_t *largest);
+bool palloc_zero_idle (void);
+void palloc_zero_stats (long long *hits, long long *misses);
+void shrinker_register (struct shrinker *);
+void shrinker_unregister (struct shrinker *);
+void shrinker_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,251 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Scheduler tracing.
+
+   Context switches and wake-ups are recorded in a ring buffer
+   that keeps the last SCHED_EVENT_CNT of them.  Recording is a
+   handful of stores done with interrupts off, so it takes no
+   locks and may happen in an interrupt handler.  The names of
+   the first SCHED_NAME_CNT threads created are kept alongside.
+
+   The "dump-sched-trace" action writes everything to the scratch
+   disk, for utils/sched-trace to turn into per-thread timelines
+   and scheduling latency histograms.  The dump is a header
+   sector followed by the events, oldest first, then the names,
+   all little-endian:
+
+     char magic[8]          "SCHTRACE"
+     uint32_t version       1
+     uint32_t timer_freq    Timer ticks per second.
+     uint32_t event_size    sizeof (struct sched_event).
+     uint32_t event_cnt     Number of events in the dump.
+     uint32_t dropped       Events overwritten before the dump.
+     uint32_t name_cnt      Number of thread names in the dump.
+
+   Each name is an int32_t tid followed by a 16-byte,
+   null-padded name. */
+
+/* If true, record scheduler events.
+   Controlled by kernel command-line option "-sched-trace". */
+bool sched_trace_enabled;
+
+#define SCHED_EVENT_CNT 4096    /* Events kept, a power of 2. */
+#define SCHED_NAME_CNT 1024     /* Thread names kept. */
+
+/* A thread name as dumped. */
+struct sched_name
+  {
+    int32_t tid;
+    char name[16];
+  };
+
+/* Dump header. */
+struct sched_header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t timer_freq;
+    uint32_t event_size;
+    uint32_t event_cnt;
+    uint32_t dropped;
+    uint32_t name_cnt;
+  };
+
+#define EVENT_PAGES DIV_ROUND_UP (SCHED_EVENT_CNT * sizeof (struct sched_event), PGSIZE)
+#define NAME_PAGES DIV_ROUND_UP (SCHED_NAME_CNT * sizeof (struct sched_name), PGSIZE)
+
+static struct sched_event *events;      /* Ring buffer, null if not tracing. */
+static uint32_t event_head;             /* Total number of events recorded. */
+static struct sched_name *names;        /* Thread names. */
+static uint32_t name_cnt;               /* Number of names recorded. */
+
+static void record (int32_t prev, int32_t next, enum sched_reason);
+static void write_out (struct block *, block_sector_t *, uint8_t *, size_t *,
+                       const void *, size_t);
+
+/* Reads the CPU's time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Allocates the trace buffers if tracing was requested. */
+void
+sched_trace_init (void)
+{
+  if (!sched_trace_enabled)
+    return;
+
+  events = palloc_get_multiple (0, EVENT_PAGES);
+  names = palloc_get_multiple (0, NAME_PAGES);
+  if (events == NULL || names == NULL)
+    PANIC ("sched-trace: out of memory for trace buffers");
+}
+
+/* Records the name of newly created thread T. */
+void
+sched_trace_name (const struct thread *t)
+{
+  enum intr_level old_level;
+
+  if (names == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (name_cnt < SCHED_NAME_CNT)
+    {
+      struct sched_name *n = &names[name_cnt++];
+      n->tid = t->tid;
+      strlcpy (n->name, t->name, sizeof n->name);
+    }
+  intr_set_level (old_level);
+}
+
+/* Records a switch from PREV to NEXT for REASON.  Interrupts
+   must be off. */
+void
+sched_trace_switch (const struct thread *prev, const struct thread *next,
+                    enum sched_reason reason)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (events != NULL)
+    record (prev->tid, next->tid, reason);
+}
+
+/* Records that T became ready to run. */
+void
+sched_trace_wake (const struct thread *t)
+{
+  enum intr_level old_level;
+
+  if (events == NULL)
+    return;
+
+  old_level = intr_disable ();
+  record (thread_current ()->tid, t->tid, SCHED_WAKE);
+  intr_set_level (old_level);
+}
+
+/* Adds an event to the ring buffer.  Interrupts must be off. */
+static void
+record (int32_t prev, int32_t next, enum sched_reason reason)
+{
+  struct sched_event *e = &events[event_head++ & (SCHED_EVENT_CNT - 1)];
+
+  e->tsc = rdtsc ();
+  e->tick = timer_ticks ();
+  e->prev = prev;
+  e->next = next;
+  e->reason = reason;
+}
+
+/* Writes the trace to the scratch disk.  Events recorded while
+   the dump is in progress are not included. */
+void
+sched_trace_dump (char **argv UNUSED)
+{
+  struct block *dst;
+  struct sched_header *h;
+  struct sched_event *copy;
+  uint8_t *sector;
+  block_sector_t sector_no = 0;
+  size_t sector_ofs = 0;
+  uint32_t head, first, i;
+  enum intr_level old_level;
+
+  if (events == NULL)
+    PANIC ("sched-trace: tracing not enabled (use -sched-trace)");
+  dst = block_get_role (BLOCK_SCRATCH);
+  if (dst == NULL)
+    PANIC ("sched-trace: couldn't open scratch device");
+
+  /* Take a consistent snapshot of the ring. */
+  copy = palloc_get_multiple (0, EVENT_PAGES);
+  sector = palloc_get_page (PAL_ZERO);
+  if (copy == NULL || sector == NULL)
+    PANIC ("sched-trace: couldn't allocate buffers");
+  old_level = intr_disable ();
+  head = event_head;
+  memcpy (copy, events, SCHED_EVENT_CNT * sizeof *copy);
+  intr_set_level (old_level);
+
+  first = head > SCHED_EVENT_CNT ? head - SCHED_EVENT_CNT : 0;
+
+  h = (struct sched_header *) sector;
+  memcpy (h->magic, "SCHTRACE", sizeof h->magic);
+  h->version = 1;
+  h->timer_freq = TIMER_FREQ;
+  h->event_size = sizeof (struct sched_event);
+  h->event_cnt = head - first;
+  h->dropped = first;
+  h->name_cnt = name_cnt;
+  block_write (dst, sector_no++, sector);
+  memset (sector, 0, BLOCK_SECTOR_SIZE);
+
+  for (i = first; i != head; i++)
+    write_out (dst, &sector_no, sector, &sector_ofs,
+               &copy[i & (SCHED_EVENT_CNT - 1)], sizeof *copy);
+  for (i = 0; i < h->name_cnt; i++)
+    write_out (dst, &sector_no, sector, &sector_ofs, &names[i], sizeof *names);
+  if (sector_ofs > 0)
+    write_out (dst, &sector_no, sector, &sector_ofs, NULL,
+               BLOCK_SECTOR_SIZE - sector_ofs);
+
+  printf ("sched-trace: wrote %"PRIu32" events and %"PRIu32" names "
+          "to %"PRDSNu" sectors\n",
+          head - first, name_cnt, sector_no);
+
+  palloc_free_page (sector);
+  palloc_free_multiple (copy, EVENT_PAGES);
+}
+
+/* Appends SIZE bytes from DATA, or SIZE zero bytes if DATA is
+   null, to the sector buffer SECTOR, of which *SECTOR_OFS bytes
+   are in use.  Each time the buffer fills, writes it to sector
+   *SECTOR_NO of DST and advances *SECTOR_NO. */
+static void
+write_out (struct block *dst, block_sector_t *sector_no, uint8_t *sector,
+           size_t *sector_ofs, const void *data_, size_t size)
+{
+  const uint8_t *data = data_;
+
+  while (size > 0)
+    {
+      size_t chunk = BLOCK_SECTOR_SIZE - *sector_ofs;
+      if (chunk > size)
+        chunk = size;
+
+      if (data != NULL)
+        {
+          memcpy (sector + *sector_ofs, data, chunk);
+          data += chunk;
+        }
+      else
+        memset (sector + *sector_ofs, 0, chunk);
+      *sector_ofs += chunk;
+      size -= chunk;
+
+      if (*sector_ofs == BLOCK_SECTOR_SIZE)
+        {
+          if (*sector_no >= block_size (dst))
+            PANIC ("sched-trace: scratch device too small");
+          block_write (dst, (*sector_no)++, sector);
+          *sector_ofs = 0;
+        }
+    }
+}
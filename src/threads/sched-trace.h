@@ -0,0 +1,43 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Why a scheduler trace event was recorded. */
+enum sched_reason
+  {
+    SCHED_YIELD,                /* Running thread yielded. */
+    SCHED_PREEMPT,              /* Running thread was preempted. */
+    SCHED_BLOCK,                /* Running thread blocked. */
+    SCHED_EXIT,                 /* Running thread exited. */
+    SCHED_WAKE                  /* A blocked or new thread became ready. */
+  };
+
+/* One scheduler trace event, in the binary form it is dumped in.
+   For SCHED_WAKE, PREV is the running thread and NEXT the thread
+   that became ready.  Otherwise PREV was switched out and NEXT
+   switched in. */
+struct sched_event
+  {
+    uint64_t tsc;               /* CPU time stamp counter. */
+    uint32_t tick;              /* Timer tick, low 32 bits. */
+    int32_t prev;               /* Thread switched out or waking. */
+    int32_t next;               /* Thread switched in or woken. */
+    uint32_t reason;            /* An enum sched_reason. */
+  };
+
+/* If true, record scheduler events.
+   Controlled by kernel command-line option "-sched-trace". */
+extern bool sched_trace_enabled;
+
+struct thread;
+
+void sched_trace_init (void);
+void sched_trace_name (const struct thread *);
+void sched_trace_switch (const struct thread *prev, const struct thread *next,
+                         enum sched_reason);
+void sched_trace_wake (const struct thread *);
+void sched_trace_dump (char **argv);
+
+#endif /* threads/sched-trace.h */
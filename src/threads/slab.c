@@ -0,0 +1,343 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator.
+
+   malloc() rounds every request up to a power of 2, so a type
+   whose size falls just past one wastes up to half of each
+   object.  A kmem_cache instead hands out objects of exactly one
+   size, packed into one-page "slabs".  Each slab starts with a
+   header followed by as many objects as fit, and keeps its free
+   objects on a singly linked list threaded through them.
+
+   A cache keeps its slabs on three lists: partial slabs, which
+   have both free and used objects and serve allocations first;
+   full slabs, which are left alone until an object is freed; and
+   empty slabs.  At most one empty slab is kept, so that a type
+   whose count hovers around a slab boundary does not take and
+   return a page on every allocation; the rest go back to the
+   page allocator.
+
+   If the cache has a constructor, it runs on each object when
+   the slab is created, not on each allocation, and objects must
+   be returned to the cache in their constructed state.  The free
+   list link of such a cache is kept just past each object, so
+   that it does not overwrite constructed fields. */
+
+/* A cache. */
+struct kmem_cache
+  {
+    char name[16];              /* Name, for debugging. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t stride;              /* Bytes from one object to the next. */
+    size_t link_ofs;            /* Offset of free list link in object. */
+    size_t first_ofs;           /* Offset of first object in slab. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct list partial;        /* Slabs with free and used objects. */
+    struct list full;           /* Slabs with no free objects. */
+    struct list empty;          /* Slabs with no used objects. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t used_cnt;            /* Number of objects in use. */
+    struct lock lock;           /* Lock. */
+    struct list_elem elem;      /* Element in cache_list. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    size_t used_cnt;            /* Number of objects in use. */
+    void *free;                 /* First free object, or null. */
+  };
+
+/* All caches, for kmem_print_stats() and kmem_shrink(). */
+static struct list cache_list = LIST_INITIALIZER (cache_list);
+
+static size_t kmem_shrink (enum palloc_flags, size_t page_cnt);
+
+/* Frees empty slabs when the kernel pool runs dry. */
+static struct shrinker kmem_shrinker =
+  {.name = "slab", .priority = 1, .shrink = kmem_shrink};
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Returns a pointer to the free list link of OBJ in cache C. */
+static inline void **
+obj_link (const struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Creates and returns a cache of objects SIZE bytes long, each
+   aligned on an ALIGN-byte boundary, which must be a power of 2,
+   or 0 for pointer alignment.  If CTOR is nonnull, it is run on
+   each object when its slab is created.  NAME is used in
+   statistics output.  Returns a null pointer if memory is not
+   available.  Panics if SIZE is too big to fit several objects
+   in a page. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+
+  if (align < sizeof (void *))
+    align = sizeof (void *);
+  ASSERT ((align & (align - 1)) == 0);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  strlcpy (c->name, name, sizeof c->name);
+  c->obj_size = size;
+  if (ctor == NULL)
+    {
+      c->link_ofs = 0;
+      c->stride = ROUND_UP (size, align);
+    }
+  else
+    {
+      c->link_ofs = ROUND_UP (size, sizeof (void *));
+      c->stride = ROUND_UP (c->link_ofs + sizeof (void *), align);
+    }
+  c->first_ofs = ROUND_UP (sizeof (struct slab), align);
+  if (c->first_ofs + c->stride * 2 > PGSIZE)
+    PANIC ("%s: %zu-byte objects are too big for a slab", name, size);
+  c->objs_per_slab = (PGSIZE - c->first_ofs) / c->stride;
+  c->ctor = ctor;
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->slab_cnt = 0;
+  c->used_cnt = 0;
+  lock_init (&c->lock);
+
+  old_level = intr_disable ();
+  if (list_empty (&cache_list))
+    shrinker_register (&kmem_shrinker);
+  list_push_back (&cache_list, &c->elem);
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Prefer partial slabs, then the empty one, then a new slab. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty))
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  else
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take its first free object. */
+  obj = s->free;
+  s->free = *obj_link (c, obj);
+  s->used_cnt++;
+  c->used_cnt++;
+  if (s->used_cnt == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C.
+   Does nothing if OBJ is a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has to stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  *obj_link (c, obj) = s->free;
+  s->free = obj;
+  c->used_cnt--;
+  if (s->used_cnt-- == c->objs_per_slab)
+    {
+      /* It was full. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->used_cnt == 0)
+    {
+      list_remove (&s->elem);
+      if (list_empty (&c->empty))
+        list_push_front (&c->empty, &s->elem);
+      else
+        {
+          c->slab_cnt--;
+          s->magic = 0;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Returns the number of slabs, that is, pages, that cache C is
+   using. */
+size_t
+kmem_cache_slab_cnt (const struct kmem_cache *c)
+{
+  return c->slab_cnt;
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu objects of %zu bytes in use, %zu slabs\n",
+              c->name, c->used_cnt, c->obj_size, c->slab_cnt);
+    }
+}
+
+/* Shrinker that frees the empty slab that each cache keeps, if
+   the kernel pool is the one short of pages.  Caches that are
+   busy are skipped.  Returns the number of pages freed. */
+static size_t
+kmem_shrink (enum palloc_flags pool, size_t page_cnt UNUSED)
+{
+  struct list_elem *e;
+  size_t released = 0;
+
+  if (pool & PAL_USER)
+    return 0;
+
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+      if (lock_held_by_current_thread (&c->lock)
+          || !lock_try_acquire (&c->lock))
+        continue;
+      while (!list_empty (&c->empty))
+        {
+          struct slab *s = list_entry (list_pop_front (&c->empty),
+                                       struct slab, elem);
+          c->slab_cnt--;
+          s->magic = 0;
+          palloc_free_page (s);
+          released++;
+        }
+      lock_release (&c->lock);
+    }
+  return released;
+}
+
+/* Obtains a page for cache C, constructs its objects, and returns
+   it as a slab with every object free.  Returns a null pointer
+   if memory is not available.  C's lock must be held. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->used_cnt = 0;
+  s->free = NULL;
+
+  /* Thread the free list from the last object back to the first,
+     so that objects are handed out in address order. */
+  obj = (uint8_t *) s + c->first_ofs + c->objs_per_slab * c->stride;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      obj -= c->stride;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *obj_link (c, obj) = s->free;
+      s->free = obj;
+    }
+
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object of cache C, is inside. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->first_ofs);
+  ASSERT ((pg_ofs (obj) - c->first_ofs) % c->stride == 0);
+
+  return s;
+}
@@ -0,0 +1,19 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* A cache of equally sized objects of one type. */
+struct kmem_cache;
+
+/* Constructor, run once on each object when its slab is created. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_cache_slab_cnt (const struct kmem_cache *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
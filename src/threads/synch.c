@@ -31,6 +31,19 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Next ticket handed to a thread that starts waiting for a lock.
+   Tickets break ties between waiters of equal priority. */
+static unsigned next_lock_ticket;
+
+static struct thread *refreshLockPriority(struct lock *lock);
+static void takeLock(struct lock *lock);
+static void waitRWLock(struct rwlock *rw, struct rwlock_share *share);
+static void shareRWLock(struct rwlock *rw, struct rwlock_share *share, struct thread *t);
+static struct rwlock_share *findShare(const struct rwlock *rw, struct thread *t);
+static int grantRWLock(struct rwlock *rw);
+static void donateToReaders(struct rwlock *rw);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -70,16 +83,51 @@ sema_down (struct semaphore *sema)
     {
       //list_push_back (&sema->waiters, &thread_current ()->elem);
       list_insert_ordered(&(sema->waiters), &thread_current()->elem, compare_Priority, NULL);
-      list_sort(&sema->waiters, compare_Priority, NULL);
-      if(!thread_mlfqs){
-          broadcastChangeInPriority(thread_current());
-      }
       thread_block ();
     }
   sema->value--;
   intr_set_level (old_level);
 }
 
+/* Down or "P" operation on a semaphore, giving up after TIMEOUT
+   timer ticks.  Returns true if SEMA was decremented, false if
+   the timeout expired first.  A TIMEOUT of 0 or less does not
+   wait at all.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t timeout)
+{
+  enum intr_level old_level;
+  struct thread *current_thread = thread_current ();
+  bool success;
+
+  ASSERT (sema != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (sema->value == 0 && timeout > 0)
+    {
+      /* Whichever comes first, sema_up() or the timing wheel,
+         takes us off the waiters list and wakes us up. */
+      timer_timeout_arm (timer_ticks () + timeout);
+      while (sema->value == 0 && !current_thread->timed_out)
+        {
+          current_thread->sema_waiting = sema;
+          list_insert_ordered(&(sema->waiters), &current_thread->elem, compare_Priority, NULL);
+          thread_block ();
+        }
+      timer_timeout_cancel ();
+    }
+  success = sema->value > 0;
+  if (success)
+    sema->value--;
+  intr_set_level (old_level);
+
+  return success;
+}
+
 /* Down or "P" operation on a semaphore, but only if the
    semaphore is not already 0.  Returns true if the semaphore is
    decremented, false otherwise.
@@ -119,11 +167,24 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)){
+      if(thread_mlfqs){
+          //blocked threads apply their missed recent_cpu decays lazily, bring the waiters up to date before comparing
+          struct list_elem *element;
+          for(element = list_begin(&sema->waiters); element != list_end(&sema->waiters); element = list_next(element))
+              catchUpRecentCPU(list_entry(element, struct thread, elem));
+      }
       list_sort(&sema->waiters, compare_Priority, NULL);
       struct thread *t = list_entry(list_pop_front(&sema->waiters), struct thread, elem);
+      t->sema_waiting = NULL;
       thread_unblock(t);
       if(t->priority > thread_current()->priority){
           sema->value++;
+          //an interrupt handler can't yield itself, so yield once it returns
+          if(intr_context()){
+              intr_yield_on_return();
+              intr_set_level (old_level);
+              return;
+          }
           intr_set_level (old_level);
           thread_yield();
           return;
@@ -192,7 +253,9 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
-  sema_init (&lock->semaphore, 1);
+  heap_init (&lock->waiters, cmp_waiters_priority, NULL);
+  lock->maxPriority = PRI_MIN;
+  lock->rwlock = NULL;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -206,38 +269,80 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+    enum intr_level old_level;
+
     ASSERT (lock != NULL);
     ASSERT (!intr_context ());
     ASSERT (!lock_held_by_current_thread (lock));
 
     struct thread *current_thread = thread_current();
-    /*make it waiting bec we are not sure it will take it or not*/
-    current_thread->lock_waiting = lock;
-    sema_down (&lock->semaphore);
-    lock->holder = thread_current ();
-    //see if any one else in the list of threads waiting for the same lock has higher priority
-    if(!thread_mlfqs){
-        /*-------  Priority Schedule and Donation    --------*/
-
-        /* the thread no longer waits for the lock.
-         * it acquired the lock */
-        current_thread -> lock_waiting = NULL;
-        if(!list_empty(&lock->semaphore.waiters)){
-            /* if there is other threads waiting for the same lock check priority
-             * make the max priority with the priority of thread with max priority in waiters*/
-            lock->maxPriority = list_entry(list_front(&lock->semaphore.waiters), struct thread, elem)->priority;
-        }
-        else{
-            /*no one is waiting for the same lock and its aquired now by the current thread
-             * so set max priority for lock to MIN_PRI which is actually 0.*/
-            lock->maxPriority = PRI_MIN;
+    old_level = intr_disable ();
+    while (lock->holder != NULL){
+        /*wait in the lock's heap of waiters, stamped so that threads of equal priority are served in arrival order*/
+        current_thread->lock_waiting = lock;
+        current_thread->lock_ticket = next_lock_ticket++;
+        heap_insert(&lock->waiters, &current_thread->lockelem);
+        if(!thread_mlfqs){
+            /*-------  Priority Schedule and Donation    --------*/
+            /*we may raise the lock's max priority and so donate to the holder (and to whoever it waits for)*/
+            struct thread *holder = refreshLockPriority(lock);
+            if(holder != NULL)
+                broadcastChangeInPriority(holder);
         }
-        //add the lock to the list of acquired locks of the current thread in descending order according to the priority holder.
-        list_insert_ordered(&lock->holder->locks_held, &lock->elem, cmp_locks_priority, NULL);
+        thread_block ();
     }
+    /* the thread no longer waits for the lock.
+     * it acquired the lock */
+    current_thread->lock_waiting = NULL;
+    lock->holder = current_thread;
+    if(!thread_mlfqs)
+        takeLock(lock);
+    intr_set_level (old_level);
+}
 
+/* Acquires LOCK like lock_acquire(), but gives up after TIMEOUT
+   timer ticks.  Returns true if LOCK was acquired, false if the
+   timeout expired first.  A thread that gives up stops donating
+   its priority to the holder.  A TIMEOUT of 0 or less does not
+   wait at all.
 
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+lock_acquire_timeout (struct lock *lock, int64_t timeout)
+{
+    enum intr_level old_level;
+    bool success;
 
+    ASSERT (lock != NULL);
+    ASSERT (!intr_context ());
+    ASSERT (!lock_held_by_current_thread (lock));
+
+    struct thread *current_thread = thread_current();
+    old_level = intr_disable ();
+    if(lock->holder != NULL && timeout > 0){
+        timer_timeout_arm(timer_ticks() + timeout);
+        while (lock->holder != NULL && !current_thread->timed_out){
+            current_thread->lock_waiting = lock;
+            current_thread->lock_ticket = next_lock_ticket++;
+            heap_insert(&lock->waiters, &current_thread->lockelem);
+            if(!thread_mlfqs){
+                struct thread *holder = refreshLockPriority(lock);
+                if(holder != NULL)
+                    broadcastChangeInPriority(holder);
+            }
+            thread_block ();
+        }
+        timer_timeout_cancel();
+    }
+    success = lock->holder == NULL;
+    if(success){
+        lock->holder = current_thread;
+        if(!thread_mlfqs)
+            takeLock(lock);
+    }
+    intr_set_level (old_level);
+    return success;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -249,14 +354,21 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+    enum intr_level old_level;
     bool success;
 
     ASSERT (lock != NULL);
     ASSERT (!lock_held_by_current_thread (lock));
 
-    success = sema_try_down (&lock->semaphore);
+    old_level = intr_disable ();
+    success = lock->holder == NULL;
     if (success)
+    {
         lock->holder = thread_current ();
+        if(!thread_mlfqs)
+            takeLock(lock);
+    }
+    intr_set_level (old_level);
     return success;
 }
 
@@ -269,19 +381,32 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+    enum intr_level old_level;
+    struct thread *t = NULL;
+
     ASSERT (lock != NULL);
     ASSERT (lock_held_by_current_thread (lock));
+
+    old_level = intr_disable ();
     if(!thread_mlfqs){
-        //remove the lock from the list of acquired locks of the current thread.
-        list_remove(&lock->elem);
+        //remove the lock from the heap of acquired locks of the current thread.
+        heap_remove(&lock->holder->locks_held, &lock->elem);
+        lock->maxPriority = PRI_MIN;
         //the thread holding the lock now left t so make threads know this and check priority
         broadcastChangeInPriority(lock->holder);
-
-        lock->maxPriority = PRI_MIN;
     }
     /*now lock isn't held*/
     lock->holder = NULL;
-    sema_up (&lock->semaphore);
+    if(!heap_empty(&lock->waiters)){
+        /*wake the highest priority waiter, it is no longer in the heap so it donates nothing until it waits again*/
+        t = heap_entry(heap_pop_max(&lock->waiters), struct thread, lockelem);
+        t->lock_waiting = NULL;
+        thread_unblock(t);
+    }
+    intr_set_level (old_level);
+
+    if(t != NULL && t->priority > thread_current()->priority)
+        thread_yield();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -294,6 +419,189 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Initializes RW.  A reader-writer lock can be held by a single
+   writer, or shared by any number of readers.  Threads waiting
+   for it are served by priority, readers at the top of the
+   waiters going in together.  Once a writer waits, new readers
+   wait as well instead of joining the current readers, so that
+   writers are not starved.  Waiters donate their priority to the
+   writer holding the rwlock, or to every reader sharing it. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  rw->lock.rwlock = rw;
+  list_init (&rw->readers);
+  rw->waiting_writers = 0;
+}
+
+/* Acquires RW shared, sleeping while a writer holds it or waits
+   for it, and records the hold in SHARE, which the caller must
+   keep until it passes it to rwlock_release_read().  The current
+   thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw, struct rwlock_share *share)
+{
+    enum intr_level old_level;
+
+    ASSERT (rw != NULL);
+    ASSERT (share != NULL);
+    ASSERT (!intr_context ());
+    ASSERT (!rwlock_held_by_current_thread (rw));
+
+    old_level = intr_disable ();
+    if(rw->lock.holder != NULL || rw->waiting_writers > 0)
+        //readers queue behind waiting writers so a stream of readers can't starve them
+        waitRWLock(rw, share);
+    else
+        shareRWLock(rw, share, thread_current());
+    intr_set_level (old_level);
+}
+
+/* Tries to acquire RW shared, recording the hold in SHARE as
+   rwlock_acquire_read() does, and returns true if successful or
+   false on failure.  The current thread must not already hold
+   RW.  This function will not sleep. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw, struct rwlock_share *share)
+{
+    enum intr_level old_level;
+    bool success;
+
+    ASSERT (rw != NULL);
+    ASSERT (share != NULL);
+    ASSERT (!rwlock_held_by_current_thread (rw));
+
+    old_level = intr_disable ();
+    success = rw->lock.holder == NULL && rw->waiting_writers == 0;
+    if(success)
+        shareRWLock(rw, share, thread_current());
+    intr_set_level (old_level);
+    return success;
+}
+
+/* Releases RW, which the current thread must hold shared through
+   SHARE.  The last reader out hands RW to the threads waiting
+   for it. */
+void
+rwlock_release_read (struct rwlock *rw, struct rwlock_share *share)
+{
+    enum intr_level old_level;
+    struct thread *current_thread = thread_current();
+    int priority = current_thread->priority;
+    int woken = PRI_MIN - 1;
+
+    ASSERT (rw != NULL);
+    ASSERT (share != NULL);
+    ASSERT (share->rwlock == rw && share->lock.holder == current_thread);
+
+    old_level = intr_disable ();
+    list_remove(&share->elem);
+    share->rwlock = NULL;
+    if(!thread_mlfqs){
+        //the readers no longer get donations through this share
+        heap_remove(&current_thread->locks_held, &share->lock.elem);
+        broadcastChangeInPriority(current_thread);
+    }
+    if(list_empty(&rw->readers))
+        woken = grantRWLock(rw);
+    intr_set_level (old_level);
+
+    //other readers may still hold the donors back, so also yield if we just lost a donation
+    if(woken > current_thread->priority || current_thread->priority < priority)
+        thread_yield();
+}
+
+/* Acquires RW exclusively, sleeping until no thread holds it.
+   The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+    enum intr_level old_level;
+    struct thread *current_thread = thread_current();
+
+    ASSERT (rw != NULL);
+    ASSERT (!intr_context ());
+    ASSERT (!rwlock_held_by_current_thread (rw));
+
+    old_level = intr_disable ();
+    if(rw->lock.holder != NULL || !list_empty(&rw->readers))
+        waitRWLock(rw, NULL);
+    else{
+        rw->lock.holder = current_thread;
+        if(!thread_mlfqs)
+            takeLock(&rw->lock);
+    }
+    intr_set_level (old_level);
+}
+
+/* Tries to acquire RW exclusively and returns true if successful
+   or false on failure.  The current thread must not already hold
+   RW.  This function will not sleep. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+    enum intr_level old_level;
+    bool success;
+
+    ASSERT (rw != NULL);
+    ASSERT (!rwlock_held_by_current_thread (rw));
+
+    old_level = intr_disable ();
+    success = rw->lock.holder == NULL && list_empty(&rw->readers);
+    if(success){
+        rw->lock.holder = thread_current();
+        if(!thread_mlfqs)
+            takeLock(&rw->lock);
+    }
+    intr_set_level (old_level);
+    return success;
+}
+
+/* Releases RW, which the current thread must hold exclusively,
+   and hands it to the threads waiting for it. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+    enum intr_level old_level;
+    int woken;
+
+    ASSERT (rw != NULL);
+    ASSERT (lock_held_by_current_thread (&rw->lock));
+
+    old_level = intr_disable ();
+    if(!thread_mlfqs){
+        heap_remove(&rw->lock.holder->locks_held, &rw->lock.elem);
+        rw->lock.maxPriority = PRI_MIN;
+        broadcastChangeInPriority(rw->lock.holder);
+    }
+    rw->lock.holder = NULL;
+    woken = grantRWLock(rw);
+    intr_set_level (old_level);
+
+    if(woken > thread_current()->priority)
+        thread_yield();
+}
+
+/* Returns true if the current thread holds RW, either shared or
+   exclusively, false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->lock)
+         || findShare (rw, thread_current ()) != NULL;
+}
 
 /* One semaphore in a list. */
 struct semaphore_elem 
@@ -351,6 +659,41 @@ cond_wait (struct condition *cond, struct lock *lock)
   lock_acquire (lock);
 }
 
+/* Like cond_wait(), but gives up waiting for COND after TIMEOUT
+   timer ticks.  Returns true if COND was signaled, false if the
+   timeout expired first.  Either way LOCK is held again on
+   return.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+cond_wait_timeout (struct condition *cond, struct lock *lock, int64_t timeout)
+{
+  struct semaphore_elem waiter;
+  bool signaled;
+
+  ASSERT (cond != NULL);
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
+
+  sema_init (&waiter.semaphore, 0);
+  list_push_back (&cond->waiters, &waiter.elem);
+  lock_release (lock);
+  signaled = sema_down_timeout (&waiter.semaphore, timeout);
+  lock_acquire (lock);
+  if (!signaled)
+    {
+      /* A signal may have picked us after the timeout but before
+         we got LOCK back.  Otherwise we are still on COND's list,
+         and nobody else can signal it while we hold LOCK. */
+      signaled = sema_try_down (&waiter.semaphore);
+      if (!signaled)
+        list_remove (&waiter.elem);
+    }
+  return signaled;
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -394,6 +737,15 @@ cond_broadcast (struct condition *cond, struct lock *lock)
     cond_signal (cond, lock);
 }
 
+/* priority of the thread behind a condition's semaphore element.  Its semaphore has no waiter while the thread
+ * is between releasing the lock and sleeping, or after its timed wait expired, so it counts as the lowest */
+static int
+cond_waiter_priority(struct semaphore_elem *sem)
+{
+    if(list_empty(&sem->semaphore.waiters))
+        return PRI_MIN - 1;
+    return list_entry(list_front(&sem->semaphore.waiters), struct thread, elem)->priority;
+}
 /*compares the priority of the threads in the waiters list of the semaphore
  * bec the list of cond inserts semaphore elements which contains the list of waiters so in each element of list
  * in cond waiting list the element is a semaphore element so we need to get the first element in the semaphore list
@@ -404,60 +756,208 @@ bool cmp_cond_priority(struct list_elem *first, struct list_elem *second, void *
     struct semaphore_elem *fsem = list_entry (first, struct semaphore_elem, elem);
     struct semaphore_elem *ssem = list_entry (second, struct semaphore_elem, elem);
 
-    return list_entry(list_front(&fsem->semaphore.waiters), struct thread, elem)->priority > list_entry (list_front(&ssem->semaphore.waiters), struct thread, elem)->priority;
+    return cond_waiter_priority(fsem) > cond_waiter_priority(ssem);
 
 }
-/* sorts the list of locks aquired by the current thread for retrieval in descending order */
-bool cmp_locks_priority(struct list_elem *first, struct list_elem *second, void *aux)
+/* orders the heap of locks aquired by a thread by the max priority of their waiters */
+bool cmp_locks_priority(const struct heap_elem *first, const struct heap_elem *second, void *aux UNUSED)
 {
-    struct lock *flock = list_entry (first, struct lock, elem);
-    struct lock *slock = list_entry (second, struct lock, elem);
+    struct lock *flock = heap_entry (first, struct lock, elem);
+    struct lock *slock = heap_entry (second, struct lock, elem);
 
-    return flock->maxPriority > slock->maxPriority;
+    return flock->maxPriority < slock->maxPriority;
 
 }
+/* orders the heap of threads waiting for a lock by priority, then by arrival (earlier ticket is greater) */
+bool cmp_waiters_priority(const struct heap_elem *first, const struct heap_elem *second, void *aux UNUSED)
+{
+    struct thread *fthread = heap_entry (first, struct thread, lockelem);
+    struct thread *sthread = heap_entry (second, struct thread, lockelem);
+
+    if (fthread->priority != sthread->priority)
+        return fthread->priority < sthread->priority;
+    return (int) (fthread->lock_ticket - sthread->lock_ticket) > 0;
+}
 /*
  * Called by a lock to notify its holder thread of a change in priority,
  * so the thread check the new priority and chooses the appropriate new priority.
+ * If it changed, the change is passed along the chain of locks the thread waits for,
+ * each hop costing O(log n) heap updates.
  */
 void broadcastChangeInPriority(struct  thread* t){
-    if(!list_empty(&(t->locks_held))){
-        /* if the thread holds another locks it sets its priority to the max bet its actual priority or
-         * the max in the list of the held threads
+    while(t != NULL){
+        /* the thread's priority is the max bet its actual priority or
+         * the max of the locks it holds, which is the top of its heap
          * */
-        int maxPriorityInWaiters = (list_entry(list_front(&(t->locks_held)),
-        struct lock, elem))->maxPriority;
-        if (t->actual_priority > maxPriorityInWaiters)
-            t->priority = t ->actual_priority;
-        else
-            t->priority = maxPriorityInWaiters;
-    }
-    else{
-        //if not holding any thread so it rebase to its actual priority
-        t->priority = t->actual_priority;
+        int priority = t->actual_priority;
+        if(!heap_empty(&t->locks_held)){
+            int maxPriorityInWaiters = heap_entry(heap_max(&t->locks_held), struct lock, elem)->maxPriority;
+            if(maxPriorityInWaiters > priority)
+                priority = maxPriorityInWaiters;
+        }
+        if(priority == t->priority)
+            //nothing changed so nothing to pass along
+            return;
+        //thread may be sitting in the run queue, so move it to its new priority queue
+        thread_set_effective_priority(t, priority);
+        t = handleNestedDonation(t);
     }
-    handleNestedDonation(t);
 }
-// Handles the nested donation procedure
-void
+// Handles one hop of the nested donation procedure: T's priority changed, so reposition it among
+// the waiters of the lock it waits for.  Returns the lock's holder if that changed the lock's max priority.
+struct thread *
 handleNestedDonation(struct thread* t){
     if (t->lock_waiting == NULL)
         //thread not waiting for anything
-        return;
+        return NULL;
 
-    list_remove(&t->elem);
-    list_insert_ordered(&t->lock_waiting->semaphore.waiters, &t->elem, compare_Priority, NULL);
-
-    if (t->lock_waiting->maxPriority < t->priority)
-        t->lock_waiting->maxPriority = t->priority;
-
-    if (t->lock_waiting->holder != NULL) {
-        int maxPriority = list_entry(list_front(&t->lock_waiting->semaphore.waiters), struct thread, elem)->priority;
-        if (t->lock_waiting->holder->priority >= maxPriority)
-            return;
+    heap_update(&t->lock_waiting->waiters, &t->lockelem);
+    return refreshLockPriority(t->lock_waiting);
+}
+/* Recomputes LOCK's max priority from the top of its waiters heap.  If it changed and the lock is held,
+   repositions the lock in its holder's heap and returns the holder, whose priority must then be updated. */
+static struct thread *
+refreshLockPriority(struct lock *lock){
+    int maxPriority = PRI_MIN;
+    if(!heap_empty(&lock->waiters))
+        maxPriority = heap_entry(heap_max(&lock->waiters), struct thread, lockelem)->priority;
+    if(lock->maxPriority == maxPriority)
+        return NULL;
+    lock->maxPriority = maxPriority;
+    if(lock->holder == NULL){
+        //an rwlock without a writer passes the change on to all of its readers
+        if(lock->rwlock != NULL)
+            donateToReaders(lock->rwlock);
+        return NULL;
+    }
+    heap_update(&lock->holder->locks_held, &lock->elem);
+    return lock->holder;
+}
+/* Makes LOCK, just acquired by the current thread, one of its held locks.  Threads still waiting for
+   the lock now donate to the current thread. */
+static void
+takeLock(struct lock *lock){
+    lock->maxPriority = PRI_MIN;
+    if(!heap_empty(&lock->waiters))
+        lock->maxPriority = heap_entry(heap_max(&lock->waiters), struct thread, lockelem)->priority;
+    heap_insert(&lock->holder->locks_held, &lock->elem);
+    broadcastChangeInPriority(lock->holder);
+}
+/* Called by the timing wheel when T's timed wait runs out.  If T still waits for a semaphore or a lock,
+   takes it off the waiters (a lock's holder loses T's donation) and wakes it up.  Otherwise T has already
+   been woken, and the timed_out flag stops it from waiting again.  Interrupts must be off. */
+void
+synch_wait_expired(struct thread *t){
+    ASSERT (intr_get_level () == INTR_OFF);
 
-        t->lock_waiting->holder->priority = maxPriority;
-        handleNestedDonation(t->lock_waiting->holder);
+    t->timed_out = true;
+    if(t->sema_waiting != NULL){
+        list_remove(&t->elem);
+        t->sema_waiting = NULL;
+    }
+    else if(t->lock_waiting != NULL){
+        struct lock *lock = t->lock_waiting;
+        heap_remove(&lock->waiters, &t->lockelem);
+        t->lock_waiting = NULL;
+        if(!thread_mlfqs){
+            struct thread *holder = refreshLockPriority(lock);
+            if(holder != NULL)
+                broadcastChangeInPriority(holder);
+        }
     }
+    else
+        return;
+    thread_unblock(t);
 }
+/* Makes the current thread wait for RW until a releasing thread hands RW over to it: as a reader
+   holding it through SHARE, or as a writer if SHARE is NULL.  Must be called with interrupts off. */
+static void
+waitRWLock(struct rwlock *rw, struct rwlock_share *share){
+    struct thread *current_thread = thread_current();
 
+    current_thread->lock_waiting = &rw->lock;
+    current_thread->share_waiting = share;
+    current_thread->lock_ticket = next_lock_ticket++;
+    heap_insert(&rw->lock.waiters, &current_thread->lockelem);
+    if(share == NULL)
+        rw->waiting_writers++;
+    if(!thread_mlfqs){
+        struct thread *holder = refreshLockPriority(&rw->lock);
+        if(holder != NULL)
+            broadcastChangeInPriority(holder);
+    }
+    thread_block();
+    ASSERT (current_thread->lock_waiting == NULL);
+}
+/* Makes T one of the readers of RW, holding it through SHARE.  Waiters of RW now donate to T. */
+static void
+shareRWLock(struct rwlock *rw, struct rwlock_share *share, struct thread *t){
+    share->rwlock = rw;
+    share->lock.holder = t;
+    list_push_back(&rw->readers, &share->elem);
+    if(!thread_mlfqs){
+        share->lock.maxPriority = rw->lock.maxPriority;
+        heap_insert(&t->locks_held, &share->lock.elem);
+        broadcastChangeInPriority(t);
+    }
+}
+/* Returns T's share of RW, or NULL if T does not hold RW shared. */
+static struct rwlock_share *
+findShare(const struct rwlock *rw, struct thread *t){
+    struct list *readers = (struct list *) &rw->readers;
+    struct list_elem *e;
+    for(e = list_begin(readers); e != list_end(readers); e = list_next(e)){
+        struct rwlock_share *share = list_entry(e, struct rwlock_share, elem);
+        if(share->lock.holder == t)
+            return share;
+    }
+    return NULL;
+}
+/* Hands RW, which no thread holds, to the waiters at the top of its heap: the highest priority writer
+   alone, or the readers ahead of the first waiting writer together.  Returns the highest priority
+   among the woken threads, or PRI_MIN - 1 if there were no waiters. */
+static int
+grantRWLock(struct rwlock *rw){
+    struct thread *t;
+    int woken = PRI_MIN - 1;
+
+    if(!heap_empty(&rw->lock.waiters)){
+        t = heap_entry(heap_max(&rw->lock.waiters), struct thread, lockelem);
+        woken = t->priority;
+        if(t->share_waiting == NULL){
+            heap_pop_max(&rw->lock.waiters);
+            rw->waiting_writers--;
+            t->lock_waiting = NULL;
+            rw->lock.holder = t;
+            if(!thread_mlfqs)
+                takeLock(&rw->lock);
+            thread_unblock(t);
+            return woken;
+        }
+        while(!heap_empty(&rw->lock.waiters)){
+            t = heap_entry(heap_max(&rw->lock.waiters), struct thread, lockelem);
+            if(t->share_waiting == NULL)
+                break;
+            heap_pop_max(&rw->lock.waiters);
+            t->lock_waiting = NULL;
+            shareRWLock(rw, t->share_waiting, t);
+            t->share_waiting = NULL;
+            thread_unblock(t);
+        }
+    }
+    if(!thread_mlfqs)
+        //the readers just let in no longer donate, the waiters left behind donate to all readers
+        refreshLockPriority(&rw->lock);
+    return woken;
+}
+/* Passes the max priority of RW's waiters on to every thread holding RW shared. */
+static void
+donateToReaders(struct rwlock *rw){
+    struct list_elem *e;
+    for(e = list_begin(&rw->readers); e != list_end(&rw->readers); e = list_next(e)){
+        struct rwlock_share *share = list_entry(e, struct rwlock_share, elem);
+        share->lock.maxPriority = rw->lock.maxPriority;
+        heap_update(&share->lock.holder->locks_held, &share->lock.elem);
+        broadcastChangeInPriority(share->lock.holder);
+    }
+}
@@ -1,8 +1,10 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -13,6 +15,7 @@ struct semaphore
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t timeout);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
@@ -21,13 +24,15 @@ void sema_self_test (void);
 struct lock 
   {
     struct thread *holder;        /* Thread holding lock (for debugging). */
-    struct semaphore semaphore;   /* Binary semaphore controlling access. */
-    struct list_elem  elem;       /* Used to link the locks a thread currently holds. */
+    struct heap waiters;          /* Threads waiting for the lock, highest priority on top. */
+    struct heap_elem elem;        /* Used to link the locks a thread currently holds. */
     int maxPriority;              /* Maximum priority of all the threads waiting for this lock */
+    struct rwlock *rwlock;        /* Reader-writer lock this lock belongs to, or NULL. */
   };
 
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
+bool lock_acquire_timeout (struct lock *, int64_t timeout);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
@@ -42,13 +47,47 @@ struct condition
 
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
+bool cond_wait_timeout (struct condition *, struct lock *, int64_t timeout);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock.  Held either by one writer or shared by
+   any number of readers.  Once a writer waits, new readers wait
+   too, so a stream of readers cannot starve writers. */
+struct rwlock
+  {
+    struct lock lock;             /* Holder is the writer.  Waiters are readers and writers. */
+    struct list readers;          /* Shares of the threads holding the rwlock shared. */
+    unsigned waiting_writers;     /* Number of writers among lock's waiters. */
+  };
+
+/* A thread's shared hold on an rwlock.  It sits in the reader's
+   heap of held locks like a lock would, so that threads waiting
+   for the rwlock donate to every reader.  The reader provides it,
+   usually on its stack, and must keep it until it releases the
+   rwlock. */
+struct rwlock_share
+  {
+    struct lock lock;             /* Stand-in lock held by the reader. */
+    struct rwlock *rwlock;        /* Rwlock held shared. */
+    struct list_elem elem;        /* Element in the rwlock's readers list. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *, struct rwlock_share *);
+bool rwlock_try_acquire_read (struct rwlock *, struct rwlock_share *);
+void rwlock_release_read (struct rwlock *, struct rwlock_share *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
 bool cmp_cond_priority(struct list_elem *first, struct list_elem *second, void *aux);
-bool cmp_locks_priority(struct list_elem *first, struct list_elem *second, void *aux);
+bool cmp_locks_priority(const struct heap_elem *first, const struct heap_elem *second, void *aux);
+bool cmp_waiters_priority(const struct heap_elem *first, const struct heap_elem *second, void *aux);
 void broadcastChangeInPriority(struct  thread* t);
-void handleNestedDonation(struct thread* t);
+struct thread *handleNestedDonation(struct thread* t);
+void synch_wait_expired (struct thread *);
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -8,6 +8,7 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/sched-trace.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -24,9 +25,14 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue: processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one
+   FIFO list per priority level, and bit P of ready_bitmap is set
+   iff ready_queues[P] is nonempty, so enqueueing is O(1) and the
+   highest-priority ready thread is found with a single bit scan. */
+static struct list ready_queues[PRI_MAX - PRI_MIN + 1];
+static uint64_t ready_bitmap;
+static size_t ready_cnt;        /* # of threads in all ready queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -54,15 +60,45 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Pages of recently exited threads, reused last in, first out
+   by thread_create().  A cached page skips the page allocator's
+   lock and bitmap scan, and only its struct thread needs zeroing,
+   which init_thread() does anyway.  Accessed with interrupts
+   off. */
+#define THREAD_CACHE_SIZE 8
+static struct thread *thread_cache[THREAD_CACHE_SIZE];
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* # of thread pages taken from the cache. */
+static long long thread_cache_misses;   /* # of thread pages taken from palloc. */
+
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static size_t thread_cache_shrink (enum palloc_flags, size_t page_cnt);
+
+/* Empties the thread page cache when the kernel pool runs dry. */
+static struct shrinker thread_cache_shrinker =
+    {.name = "thread-cache", .priority = 2, .shrink = thread_cache_shrink};
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+static bool preempting;         /* Yielding because an interrupt asked to. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 real load_average;
+
+/* MLFQS epochs.  An epoch ends every second, when recent_cpu is
+   decayed by a factor that depends on the load average.  The
+   factors of the last DECAY_HISTORY epochs are kept so that a
+   thread that was blocked can apply the decays it missed when it
+   wakes up, instead of every thread being decayed every second. */
+#define DECAY_HISTORY 256
+static int mlfqs_epoch;                         /* Current epoch. */
+static real decay_history[DECAY_HISTORY];       /* Factor that ended each epoch. */
+static int64_t mlfqs_updates;                   /* # of per-thread MLFQS recomputations. */
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -72,8 +108,12 @@ static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static enum sched_reason schedule_reason (const struct thread *);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -91,11 +131,17 @@ static tid_t allocate_tid (void);
 void
 thread_init (void)
 {
+    int pri;
+
     ASSERT (intr_get_level () == INTR_OFF);
 
     lock_init (&tid_lock);
-    list_init (&ready_list);
+    for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+        list_init (&ready_queues[pri - PRI_MIN]);
+    ready_bitmap = 0;
+    ready_cnt = 0;
     list_init (&all_list);
+    shrinker_register (&thread_cache_shrinker);
 
     /* Set up a thread structure for the running thread. */
     initial_thread = running_thread ();
@@ -136,28 +182,71 @@ void updateLoadAverage() {
     }
     // not idle thread
     enum intr_level old_level = intr_disable();
-    int ready_threads = list_size(&ready_list) + 1; // one is for current running thread
+    int ready_threads = ready_cnt + 1; // one is for current running thread
     load_average = add_fp_fp(mul_fp_fp(div_fp_fp(int_to_fp(59), int_to_fp(60)), load_average),mul_fp_fp(div_fp_fp(int_to_fp(1), int_to_fp(60)), int_to_fp(ready_threads)));
     intr_set_level(old_level);
 }
-void updateRecentCPUForALL(real fraction){
-    enum intr_level old_level = intr_disable();
-    struct list_elem *element;
-    for (element = list_begin (&all_list); element != list_end (&all_list);element = list_next (element)){
-        struct thread *t = list_entry (element, struct thread, allelem);
-        t->recent_cpu = add_fp_int(mul_fp_fp(fraction, t->recent_cpu), t->nice);
+/* Applies to T the once-a-second recent_cpu decays it has missed
+   since its cpu_epoch, then recomputes its priority.  Running and
+   ready threads are kept current every second, so only threads
+   that were blocked ever lag behind; they catch up here when they
+   become ready again. */
+void catchUpRecentCPU(struct thread *t){
+    ASSERT (intr_get_level () == INTR_OFF);
+    int lag = mlfqs_epoch - t->cpu_epoch;
+    if(lag == 0)
+        return;
+    if(lag > DECAY_HISTORY){
+        //decays older than the history are lost, so take the steady state
+        //of recent_cpu = factor * recent_cpu + nice, i.e. nice * (2 * load_avg + 1)
+        t->recent_cpu = mul_fp_int(add_fp_int(mul_fp_int(load_average, 2), 1), t->nice);
     }
-    intr_set_level(old_level);
+    else{
+        int epoch;
+        for(epoch = t->cpu_epoch + 1; epoch <= mlfqs_epoch; epoch++)
+            t->recent_cpu = add_fp_int(mul_fp_fp(decay_history[epoch % DECAY_HISTORY], t->recent_cpu), t->nice);
+    }
+    t->cpu_epoch = mlfqs_epoch;
+    updatePriority(t, NULL);
 }
-void updatePriority(struct thread *t, void* aux){ //use update priority in setting nice value to check weather to yield current thread or not
-    enum intr_level old_level = intr_disable();
-    t->priority = PRI_MAX - fp_to_int_round_to_nearest(div_fp_int(t->recent_cpu, 4)) - (t->nice * 2);
-    intr_set_level(old_level);
+/* Once a second: updates the load average, starts a new epoch and
+   decays recent_cpu of the running thread and of every ready
+   thread, which may move between ready queues.  Blocked threads
+   are left alone until catchUpRecentCPU(). */
+void
+advanceEpoch (void)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+    updateLoadAverage();
+    mlfqs_epoch++;
+    decay_history[mlfqs_epoch % DECAY_HISTORY] = div_fp_fp(mul_fp_int(load_average, 2), add_fp_int(mul_fp_int(load_average, 2), 1));
+
+    struct thread *currentThread = thread_current();
+    if(currentThread != idle_thread)
+        catchUpRecentCPU(currentThread);
+
+    int pri;
+    for(pri = PRI_MAX; pri >= PRI_MIN; pri--){
+        struct list *queue = &ready_queues[pri - PRI_MIN];
+        struct list_elem *element, *next;
+        for(element = list_begin(queue); element != list_end(queue); element = next){
+            //a thread whose priority changes moves to another queue, so step first.
+            //if we meet it again there it is already current and is skipped
+            next = list_next(element);
+            catchUpRecentCPU(list_entry(element, struct thread, elem));
+        }
+    }
 }
-void updatePriorityForAll(){
-    //update priority of each thread in the system
+void updatePriority(struct thread *t, void* aux UNUSED){ //use update priority in setting nice value to check weather to yield current thread or not
     enum intr_level old_level = intr_disable();
-    thread_foreach(updatePriority,NULL);
+    mlfqs_updates++;
+    int priority = PRI_MAX - fp_to_int_round_to_nearest(div_fp_int(t->recent_cpu, 4)) - (t->nice * 2);
+    //clamp to the valid range, the run queue is indexed by priority
+    if (priority < PRI_MIN)
+        priority = PRI_MIN;
+    else if (priority > PRI_MAX)
+        priority = PRI_MAX;
+    thread_set_effective_priority(t, priority);
     intr_set_level(old_level);
 }
 void AdvancedScheduleHandler(){
@@ -167,15 +256,13 @@ void AdvancedScheduleHandler(){
         currentThread->recent_cpu = add_fp_int(currentThread->recent_cpu, 1);
     }
     if(timer_ticks() % TIMER_FREQ == 0){
-        //every second update the load average and recent_cpu of all threads
-        updateLoadAverage();
-        real factor = div_fp_fp(mul_fp_int(load_average, 2), add_fp_int(mul_fp_int(load_average, 2), 1));
-        updateRecentCPUForALL(factor);
-
+        //every second update the load average and recent_cpu of the running and ready threads
+        advanceEpoch();
     }
-    if(timer_ticks() % 4 == 0){
-        //every fourth tick update the priority of all threads
-        updatePriorityForAll();
+    if(timer_ticks() % 4 == 0 && currentThread != idle_thread){
+        //every fourth tick update the priority of the running thread,
+        //the only one whose recent_cpu changed since the last time
+        updatePriority(currentThread, NULL);
     }
 }
 void
@@ -206,12 +293,65 @@ thread_tick (void)
         intr_yield_on_return ();
 }
 
+/* Accounts for CNT timer ticks that went by without a timer
+   interrupt while the idle thread had the CPU halted (see
+   timer_idle_enter()).  Called with interrupts off, after
+   timer_ticks() has been advanced past those ticks.  Nothing but
+   idle ran, so only the once-a-second MLFQS updates need to be
+   replayed; the per-tick and every-4-ticks ones would change
+   nothing. */
+void
+thread_idle_catch_up (int64_t cnt)
+{
+    int64_t now = timer_ticks ();
+    int64_t t;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    idle_ticks += cnt;
+    if (!thread_mlfqs)
+        return;
+
+    for (t = now - cnt + 1; t <= now; t++)
+        if (t % TIMER_FREQ == 0)
+            advanceEpoch();
+}
+
+/* Returns the number of times a thread's MLFQS priority has been
+   recomputed since boot. */
+int64_t
+thread_mlfqs_updates (void)
+{
+    enum intr_level old_level = intr_disable ();
+    int64_t updates = mlfqs_updates;
+    intr_set_level (old_level);
+    return updates;
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void)
 {
+    long long zero_hits, zero_misses;
+
     printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
             idle_ticks, kernel_ticks, user_ticks);
+    printf ("Thread: %lld pages from cache, %lld from page allocator\n",
+            thread_cache_hits, thread_cache_misses);
+    palloc_zero_stats (&zero_hits, &zero_misses);
+    printf ("Thread: %lld zeroed pages from idle, %lld zeroed on demand\n",
+            zero_hits, zero_misses);
+}
+
+/* Returns the number of new threads whose page came from the
+   cache of exited threads' pages since boot. */
+int64_t
+thread_cache_hit_cnt (void)
+{
+    enum intr_level old_level = intr_disable ();
+    int64_t hits = thread_cache_hits;
+    intr_set_level (old_level);
+    return hits;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -242,13 +382,14 @@ thread_create (const char *name, int priority,
     ASSERT (function != NULL);
 
     /* Allocate thread. */
-    t = palloc_get_page (PAL_ZERO);
+    t = thread_page_get ();
     if (t == NULL)
         return TID_ERROR;
 
     /* Initialize thread. */
     init_thread (t, name, priority);
     tid = t->tid = allocate_tid ();
+    sched_trace_name (t);
 
     /* Stack frame for kernel_thread(). */
     kf = alloc_frame (t, sizeof *kf);
@@ -326,10 +467,11 @@ thread_unblock (struct thread *t)
 
     old_level = intr_disable ();
     ASSERT (t->status == THREAD_BLOCKED);
-    //list_push_back (&ready_list, &t->elem);
-    list_insert_ordered(&ready_list, &t->elem, compare_Priority, NULL);//inserts descendingly ordered according to priority
-    list_sort(&ready_list, compare_Priority, NULL);
+    if (thread_mlfqs)
+        catchUpRecentCPU (t);
+    ready_queue_push (t);
     t->status = THREAD_READY;
+    sched_trace_wake (t);
     intr_set_level (old_level);
 }
 
@@ -398,16 +540,25 @@ thread_yield (void)
     ASSERT (!intr_context ());
 
     old_level = intr_disable ();
-    if (cur != idle_thread){
-        //list_push_back (&ready_list, &cur->elem);
-        list_insert_ordered(&ready_list, &cur->elem, compare_Priority, NULL);//inserts descendingly ordered according to priority
-        list_sort(&ready_list, compare_Priority, NULL);
-    }
+    if (cur != idle_thread)
+        ready_queue_push (cur);
     cur->status = THREAD_READY;
     schedule ();
     intr_set_level (old_level);
 }
 
+/* Yields the CPU on behalf of an interrupt handler that called
+   intr_yield_on_return().  Only differs from thread_yield() in how
+   the switch is traced. */
+void
+thread_preempt (void)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    preempting = true;
+    thread_yield ();
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -437,16 +588,10 @@ thread_set_priority (int new_priority)
     broadcastChangeInPriority(currentThread);
     /* If there are threads with higher priority than the current thread, call
    THREAD YIELD. */
-    if(list_size(&ready_list) > 0){
-        //list not empty
-        struct list_elem *element = list_front(&ready_list);
-        struct thread *t = list_entry(element, struct thread, elem);
-        if(t->priority > currentThread->priority){
-            intr_set_level(old_level);
-            thread_yield();
-            return;
-
-        }
+    if(ready_queue_max_priority() > currentThread->priority){
+        intr_set_level(old_level);
+        thread_yield();
+        return;
     }
     intr_set_level(old_level);
 }
@@ -466,16 +611,10 @@ thread_set_nice (int nice UNUSED)
     struct thread *currentThread = thread_current();
     currentThread->nice = nice;
     updatePriority(currentThread, NULL);
-    if(list_size(&ready_list) > 0){
-        //list not empty
-        struct list_elem *element = list_front(&ready_list);
-        struct thread *t = list_entry(element, struct thread, elem);
-        if(t->priority > currentThread->priority){
-            intr_set_level(old_level);
-            thread_yield();
-            return;
-
-        }
+    if(ready_queue_max_priority() > currentThread->priority){
+        intr_set_level(old_level);
+        thread_yield();
+        return;
     }
     intr_set_level(old_level);
 
@@ -527,6 +666,20 @@ idle (void *idle_started_ UNUSED)
         intr_disable ();
         thread_block ();
 
+        /* While nothing else is runnable, zero free pages for
+           later PAL_ZERO requests.  Interrupts are on meanwhile,
+           so a thread that wakes up preempts us. */
+        intr_enable ();
+        while (ready_cnt == 0 && palloc_zero_idle ())
+            continue;
+        intr_disable ();
+        if (ready_cnt != 0)
+            continue;
+
+        /* Nothing else is runnable.  In tickless mode, stop the
+           periodic tick until the next sleeper is due. */
+        timer_idle_enter ();
+
         /* Re-enable interrupts and wait for the next one.
 
            The `sti' instruction disables interrupts until the
@@ -540,6 +693,7 @@ idle (void *idle_started_ UNUSED)
            See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
            7.11.1 "HLT Instruction". */
         asm volatile ("sti; hlt" : : : "memory");
+        timer_idle_exit ();
     }
 }
 
@@ -592,7 +746,15 @@ init_thread (struct thread *t, const char *name, int priority)
      * so it is the base priority to refer to it in the get priority*/
     memset (t, 0, sizeof *t);
 
-    list_init(&t->locks_held);
+    heap_init(&t->locks_held, cmp_locks_priority, NULL);
+#ifdef USERPROG
+    list_init (&t->children);
+    list_init (&t->fds);
+    t->next_fd = 2;
+#endif
+#ifdef VM
+    list_init (&t->mappings);
+#endif
 
     t->status = THREAD_BLOCKED;
     strlcpy (t->name, name, sizeof t->name);
@@ -601,6 +763,7 @@ init_thread (struct thread *t, const char *name, int priority)
     t->magic = THREAD_MAGIC;
 
     t->actual_priority = priority;
+    t->cpu_epoch = mlfqs_epoch;
 
 
     old_level = intr_disable ();
@@ -629,10 +792,86 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void)
 {
-    if (list_empty (&ready_list))
+    struct thread *t;
+
+    if (ready_bitmap == 0)
         return idle_thread;
+
+    t = list_entry (list_front (&ready_queues[ready_queue_max_priority () - PRI_MIN]),
+                    struct thread, elem);
+    ready_queue_remove (t);
+    return t;
+}
+
+/* Appends T to the back of the run queue for its priority. */
+static void
+ready_queue_push (struct thread *t)
+{
+    int idx = t->priority - PRI_MIN;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+    ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+    list_push_back (&ready_queues[idx], &t->elem);
+    ready_bitmap |= (uint64_t) 1 << idx;
+    ready_cnt++;
+}
+
+/* Removes T, which must be in the run queue for its current
+   priority, from the run queue. */
+static void
+ready_queue_remove (struct thread *t)
+{
+    int idx = t->priority - PRI_MIN;
+
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    list_remove (&t->elem);
+    if (list_empty (&ready_queues[idx]))
+        ready_bitmap &= ~((uint64_t) 1 << idx);
+    ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   PRI_MIN - 1 if the run queue is empty.  The bitmap is scanned
+   as two 32-bit halves so that no libgcc helper is needed. */
+static int
+ready_queue_max_priority (void)
+{
+    uint32_t high = ready_bitmap >> 32;
+    uint32_t low = ready_bitmap;
+
+    if (high != 0)
+        return PRI_MIN + 63 - __builtin_clz (high);
+    else if (low != 0)
+        return PRI_MIN + 31 - __builtin_clz (low);
     else
-        return list_entry (list_pop_front (&ready_list), struct thread, elem);
+        return PRI_MIN - 1;
+}
+
+/* Sets T's effective priority to PRIORITY.  If T is in the run
+   queue it is moved to the queue for its new priority, which
+   takes O(1) time. */
+void
+thread_set_effective_priority (struct thread *t, int priority)
+{
+    enum intr_level old_level;
+
+    ASSERT (is_thread (t));
+
+    if (t->priority == priority)
+        return;
+
+    old_level = intr_disable ();
+    if (t->status == THREAD_READY && t != idle_thread)
+    {
+        ready_queue_remove (t);
+        t->priority = priority;
+        ready_queue_push (t);
+    }
+    else
+        t->priority = priority;
+    intr_set_level (old_level);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -677,8 +916,68 @@ thread_schedule_tail (struct thread *prev)
     if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
         ASSERT (prev != cur);
-        palloc_free_page (prev);
+        thread_page_put (prev);
+    }
+}
+
+/* Returns a page for a new thread, the most recently freed one
+   in the thread page cache if there is one.  The page is not
+   zeroed: init_thread() clears the struct thread, and the rest
+   of the page is stack.  Returns a null pointer if no page is
+   available. */
+static struct thread *
+thread_page_get (void)
+{
+    enum intr_level old_level = intr_disable ();
+    struct thread *t = NULL;
+
+    if (thread_cache_cnt > 0)
+    {
+        t = thread_cache[--thread_cache_cnt];
+        thread_cache_hits++;
     }
+    else
+        thread_cache_misses++;
+    intr_set_level (old_level);
+
+    if (t == NULL)
+        t = palloc_get_page (0);
+    return t;
+}
+
+/* Frees the page of dead thread T, keeping it in the thread page
+   cache if there is room.  Interrupts must be off. */
+static void
+thread_page_put (struct thread *t)
+{
+    ASSERT (intr_get_level () == INTR_OFF);
+
+    if (thread_cache_cnt < THREAD_CACHE_SIZE)
+        thread_cache[thread_cache_cnt++] = t;
+    else
+        palloc_free_page (t);
+}
+
+/* Shrinker that frees every page in the thread page cache, if
+   the kernel pool is the one short of pages.  Returns the number
+   of pages freed. */
+static size_t
+thread_cache_shrink (enum palloc_flags pool, size_t page_cnt UNUSED)
+{
+    enum intr_level old_level;
+    size_t released = 0;
+
+    if (pool & PAL_USER)
+        return 0;
+
+    old_level = intr_disable ();
+    while (thread_cache_cnt > 0)
+    {
+        palloc_free_page (thread_cache[--thread_cache_cnt]);
+        released++;
+    }
+    intr_set_level (old_level);
+    return released;
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
@@ -699,11 +998,25 @@ schedule (void)
     ASSERT (cur->status != THREAD_RUNNING);
     ASSERT (is_thread (next));
 
+    if (cur != next)
+        sched_trace_switch (cur, next, schedule_reason (cur));
+    preempting = false;
     if (cur != next)
         prev = switch_threads (cur, next);
     thread_schedule_tail (prev);
 }
 
+/* Returns why CUR, the running thread, is being switched out. */
+static enum sched_reason
+schedule_reason (const struct thread *cur)
+{
+    if (cur->status == THREAD_DYING)
+        return SCHED_EXIT;
+    if (cur->status == THREAD_BLOCKED)
+        return SCHED_BLOCK;
+    return preempting ? SCHED_PREEMPT : SCHED_YIELD;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void)
@@ -722,12 +1035,6 @@ allocate_tid (void)
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
 
-//return true if a thread one  wakeUpTime is less than thread two wakeUpTime.
-bool compare_wakeUpTime(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
-    struct thread *thread_one = list_entry(a, struct thread, elem);
-    struct thread *thread_two = list_entry(b, struct thread, elem);
-    return thread_one->wakeUpTime < thread_two->wakeUpTime;
-}
 //return true if a thread one  priority is greater than thread two priority.
 bool compare_Priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
     struct thread *thread_one = list_entry(a, struct thread, elem);
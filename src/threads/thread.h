@@ -2,9 +2,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/fixed-point.h"
+#include "threads/synch.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -95,22 +97,49 @@ struct thread
     /*-----------For Advance Schedule----------*/
     int nice;
     real recent_cpu;
+    int cpu_epoch;                      /* Last MLFQS epoch applied to recent_cpu. */
 
     /*-----------For Alarm Clock----------*/
-    int wakeUpTime;                     /* Time to wake up the thread */
+    int64_t wakeUpTime;                 /* Time to wake up the thread */
+    struct list_elem sleepelem;         /* Element in a timing wheel slot. */
+    bool timed_wait;                    /* On the timing wheel for a timed wait, not a sleep. */
+    bool timed_out;                     /* The timed wait's deadline passed. */
  
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
     /*-------- Priority scheduling and donation ------------------ */
     int actual_priority;                /* Priority represents actual priority of thread  from it's aquired locks */
+    struct semaphore *sema_waiting;     /* Semaphore the thread waits for with a timeout. */
     struct lock *lock_waiting;          /* Lock thread is waiting for.(Thread benn locked by this lock) */
-    struct list locks_held;             /* Locks the thread currently holds.(All locks held) */
+    struct heap_elem lockelem;          /* Element in the waiters heap of lock_waiting. */
+    unsigned lock_ticket;               /* Arrival order among lock_waiting's waiters. */
+    struct heap locks_held;             /* Locks the thread currently holds, max priority on top.(All locks held) */
+    struct rwlock_share *share_waiting; /* Share to fill in if waiting for lock_waiting's rwlock as a reader, else NULL. */
 
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct list children;               /* Exit status records of children. */
+    struct child *child;                /* Our record in our parent's list. */
+
+    /* Owned by userprog/syscall.c. */
+    struct list fds;                    /* Open file descriptors. */
+    int next_fd;                        /* Next file descriptor to hand out. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+    void *fault_next;                   /* Sequential fault expected here. */
+    unsigned fault_window;              /* Pages to fault around. */
+
+    /* Owned by userprog/process.c. */
+    struct file *exec_file;             /* Executable that PAGES reads. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping id to hand out. */
 #endif
 
     /* Owned by thread.c. */
@@ -126,6 +155,9 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+void thread_idle_catch_up (int64_t cnt);
+int64_t thread_mlfqs_updates (void);
+int64_t thread_cache_hit_cnt (void);
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -140,6 +172,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -147,17 +180,17 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_set_effective_priority (struct thread *, int);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-bool compare_wakeUpTime(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 bool compare_Priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void updateLoadAverage();
-void updateRecentCPUForALL(real fraction);
-void updatePriorityForAll();
+void catchUpRecentCPU(struct thread *t);
+void advanceEpoch (void);
 void AdvancedScheduleHandler();
 void updatePriority(struct thread *t, void* aux);
 #endif /* threads/thread.h */
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocations.
+
+   palloc_get_multiple() needs physically contiguous pages, which
+   a fragmented pool may not have even when plenty of pages are
+   free.  vmalloc() instead takes pages one at a time and maps
+   them at consecutive addresses in a kernel virtual address
+   region set aside for it just above the mapping of physical
+   memory.  The page after each allocation is left unmapped, so
+   that running off its end faults instead of corrupting the next
+   allocation.
+
+   The region's page tables are created up front in
+   init_page_dir, so that every page directory copied from it by
+   pagedir_create() sees later vmalloc() mappings without being
+   updated.  Memory from vmalloc() must not be given to hardware
+   or to vtop(), because it has no single physical address. */
+
+/* Maximum size of the vmalloc region. */
+#define VMALLOC_MAX_SIZE (64 * 1024 * 1024)
+
+/* Highest address the region may reach.  The top 4 MB of the
+   address space is left unused. */
+#define VMALLOC_LIMIT ((uintptr_t) 0 - PTSPAN)
+
+static uint8_t *vm_start, *vm_end;      /* Bounds of the region. */
+static size_t vm_page_cnt;              /* Pages in the region. */
+static struct bitmap *vm_map;           /* Pages in use, guard pages too. */
+static uint16_t *vm_sizes;              /* Page count, by first page. */
+static struct lock vm_lock;             /* Protects vm_map, vm_sizes. */
+
+static uint32_t *lookup_pte (const void *);
+static void unmap_pages (uint8_t *start, size_t page_cnt);
+
+/* Sets up the vmalloc region just above the kernel's mapping of
+   physical memory.  Must be called after paging_init() and before
+   any page directory is created. */
+void
+vmalloc_init (void)
+{
+  uintptr_t start = ROUND_UP ((uintptr_t) ptov (init_ram_pages * PGSIZE),
+                              PTSPAN);
+  size_t size = VMALLOC_MAX_SIZE;
+  size_t bm_pages, size_pages;
+  uint8_t *pd_page;
+
+  if (start >= VMALLOC_LIMIT)
+    return;
+  if (size > VMALLOC_LIMIT - start)
+    size = VMALLOC_LIMIT - start;
+
+  /* Create page tables for the whole region. */
+  for (pd_page = (uint8_t *) start; pd_page < (uint8_t *) start + size;
+       pd_page += PTSPAN)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      ASSERT (init_page_dir[pd_no (pd_page)] == 0);
+      init_page_dir[pd_no (pd_page)] = pde_create (pt);
+    }
+
+  vm_start = (uint8_t *) start;
+  vm_end = vm_start + size;
+  vm_page_cnt = size / PGSIZE;
+  lock_init (&vm_lock);
+
+  bm_pages = DIV_ROUND_UP (bitmap_buf_size (vm_page_cnt), PGSIZE);
+  vm_map = bitmap_create_in_buf (vm_page_cnt,
+                                 palloc_get_multiple (PAL_ASSERT, bm_pages),
+                                 bm_pages * PGSIZE);
+  size_pages = DIV_ROUND_UP (vm_page_cnt * sizeof *vm_sizes, PGSIZE);
+  vm_sizes = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, size_pages);
+}
+
+/* Obtains and returns SIZE bytes of virtually contiguous kernel
+   memory, made up of individually allocated pages, or a null
+   pointer if memory or address space is not available.  The
+   memory is page-aligned and not zeroed. */
+void *
+vmalloc (size_t size)
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  size_t start_idx, i;
+  uint8_t *start;
+
+  if (size == 0 || vm_map == NULL)
+    return NULL;
+
+  /* Reserve address space, plus a guard page. */
+  lock_acquire (&vm_lock);
+  start_idx = bitmap_scan_and_flip (vm_map, 0, page_cnt + 1, false);
+  if (start_idx != BITMAP_ERROR)
+    vm_sizes[start_idx] = page_cnt;
+  lock_release (&vm_lock);
+  if (start_idx == BITMAP_ERROR)
+    return NULL;
+  start = vm_start + start_idx * PGSIZE;
+
+  /* Back it with pages. */
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *page = palloc_get_page (0);
+      if (page == NULL)
+        {
+          unmap_pages (start, i);
+          lock_acquire (&vm_lock);
+          bitmap_set_multiple (vm_map, start_idx, page_cnt + 1, false);
+          lock_release (&vm_lock);
+          return NULL;
+        }
+      *lookup_pte (start + i * PGSIZE) = pte_create_kernel (page, true);
+    }
+  return start;
+}
+
+/* Frees P, which must have been returned by vmalloc().  Does
+   nothing if P is a null pointer. */
+void
+vfree (void *p)
+{
+  size_t start_idx, page_cnt;
+
+  if (p == NULL)
+    return;
+  ASSERT (is_vmalloc_addr (p));
+  ASSERT (pg_ofs (p) == 0);
+
+  start_idx = ((uint8_t *) p - vm_start) / PGSIZE;
+  lock_acquire (&vm_lock);
+  page_cnt = vm_sizes[start_idx];
+  ASSERT (page_cnt > 0);
+  ASSERT (bitmap_all (vm_map, start_idx, page_cnt + 1));
+  vm_sizes[start_idx] = 0;
+  lock_release (&vm_lock);
+
+  unmap_pages (p, page_cnt);
+
+  lock_acquire (&vm_lock);
+  bitmap_set_multiple (vm_map, start_idx, page_cnt + 1, false);
+  lock_release (&vm_lock);
+}
+
+/* Returns true if P is in the vmalloc region. */
+bool
+is_vmalloc_addr (const void *p)
+{
+  return (const uint8_t *) p >= vm_start && (const uint8_t *) p < vm_end;
+}
+
+/* Returns the kernel page table entry for VADDR, which must be in
+   the vmalloc region. */
+static uint32_t *
+lookup_pte (const void *vaddr)
+{
+  ASSERT (is_vmalloc_addr (vaddr));
+  return pde_get_pt (init_page_dir[pd_no (vaddr)]) + pt_no (vaddr);
+}
+
+/* Unmaps the PAGE_CNT pages starting at START and frees the pages
+   behind them. */
+static void
+unmap_pages (uint8_t *start, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint8_t *vaddr = start + i * PGSIZE;
+      uint32_t *pte = lookup_pte (vaddr);
+
+      ASSERT (*pte & PTE_P);
+      palloc_free_page (pte_get_page (*pte));
+      *pte = 0;
+
+      /* Drop any stale translation.  See [IA32-v2a] "INVLPG". */
+      asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+    }
+}
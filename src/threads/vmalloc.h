@@ -0,0 +1,12 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void vmalloc_init (void);
+void *vmalloc (size_t size) __attribute__ ((malloc));
+void vfree (void *);
+bool is_vmalloc_addr (const void *);
+
+#endif /* threads/vmalloc.h */
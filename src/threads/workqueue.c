@@ -0,0 +1,114 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Workqueue for work deferred by device interrupt handlers.
+   Items queued before it is started wait until workqueue_start()
+   gives it its workers. */
+struct workqueue system_wq;
+
+static thread_func worker;
+
+/* Initializes WQ, named NAME, without any worker threads.  Work
+   may be queued on it right away, but it does not run until
+   workqueue_start() is called. */
+void
+workqueue_init (struct workqueue *wq, const char *name)
+{
+  ASSERT (wq != NULL);
+  ASSERT (name != NULL);
+
+  strlcpy (wq->name, name, sizeof wq->name);
+  list_init (&wq->items);
+  sema_init (&wq->item_cnt, 0);
+  wq->worker_cnt = 0;
+}
+
+/* Starts WORKER_CNT more worker threads for WQ, each running at
+   PRIORITY under the priority scheduler.  Under the MLFQS the
+   workers instead run at the lowest nice value, since their
+   priority cannot be set. */
+void
+workqueue_start (struct workqueue *wq, int priority, int worker_cnt)
+{
+  ASSERT (wq != NULL);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  for (; worker_cnt > 0; worker_cnt--)
+    {
+      char name[sizeof wq->name + 12];
+
+      snprintf (name, sizeof name, "%s/%d", wq->name, wq->worker_cnt++);
+      if (thread_create (name, priority, worker, wq) == TID_ERROR)
+        PANIC ("%s: couldn't create worker thread", wq->name);
+    }
+}
+
+/* Initializes work item W to run FUNC. */
+void
+work_init (struct work *w, work_func *func)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->pending = false;
+}
+
+/* Queues W on WQ, to be run by one of WQ's worker threads.
+   Returns false, without queuing it again, if W is already
+   pending.  Once a worker picks W up it is no longer pending, so
+   W may be queued again while it runs.
+
+   This function does not sleep, so it may be called from an
+   interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  if (w->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  w->pending = true;
+  list_push_back (&wq->items, &w->elem);
+  intr_set_level (old_level);
+
+  sema_up (&wq->item_cnt);
+  return true;
+}
+
+/* Worker thread.  Runs the work items queued on workqueue WQ_,
+   one at a time, in the order they were queued. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  if (thread_mlfqs)
+    thread_set_nice (-20);
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      sema_down (&wq->item_cnt);
+
+      old_level = intr_disable ();
+      w = list_entry (list_pop_front (&wq->items), struct work, elem);
+      w->pending = false;
+      intr_set_level (old_level);
+
+      w->func (w);
+    }
+}
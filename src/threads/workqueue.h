@@ -0,0 +1,38 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/synch.h"
+
+struct work;
+typedef void work_func (struct work *);
+
+/* A deferred work item.  Usually embedded in a larger structure,
+   which FUNC gets back to with list_entry()-style pointer math. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a workqueue's item list. */
+    work_func *func;            /* Function that does the work. */
+    bool pending;               /* Queued but not yet started. */
+  };
+
+/* A queue of work items served by kernel worker threads. */
+struct workqueue
+  {
+    char name[16];              /* Name, worker threads are named after it. */
+    struct list items;          /* Pending work items. */
+    struct semaphore item_cnt;  /* Number of pending work items. */
+    int worker_cnt;             /* Number of worker threads. */
+  };
+
+/* Workqueue for work deferred by device interrupt handlers. */
+extern struct workqueue system_wq;
+
+void workqueue_init (struct workqueue *, const char *name);
+void workqueue_start (struct workqueue *, int priority, int worker_cnt);
+
+void work_init (struct work *, work_func *);
+bool work_queue (struct workqueue *, struct work *);
+
+#endif /* threads/workqueue.h */
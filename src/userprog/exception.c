@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,6 +152,28 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Bring in a page of the process's address space on first
+     access, or give the process its own copy of a page it shares
+     copy-on-write on first write.  The kernel faults here too
+     when it touches a user buffer that isn't resident yet. */
+  if (is_user_vaddr (fault_addr)
+      && (not_present
+          ? page_fault_in (fault_addr)
+          : write && page_unshare (fault_addr)))
+    return;
+#endif
+
+  /* The kernel touched a bad user address in get_user() in
+     userprog/syscall.c, which left where to resume in %eax.
+     Resume there with -1 in %eax to report the failure. */
+  if (!user && is_user_vaddr (fault_addr))
+    {
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0xffffffff;
+      return;
+    }
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -17,13 +17,17 @@ uint32_t *
 pagedir_create (void) 
 {
   uint32_t *pd = palloc_get_page (0);
+
+  /* The kernel's mappings, including its 4 MB pages, are shared
+     with every process by copying the PDEs that point to them. */
   if (pd != NULL)
     memcpy (pd, init_page_dir, PGSIZE);
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  Only the user part of PD is walked; the kernel
+   part, 4 MB pages included, belongs to init_page_dir. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -34,7 +38,7 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & PTE_P) && !(*pde & PTE_PS))
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
@@ -156,6 +160,23 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Makes the PTE for user virtual page UPAGE in PD read/write if
+   WRITABLE is true, read-only otherwise.
+   UPAGE need not be mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -14,57 +15,102 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "devices/timer.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* A child process's exit status, shared between the child and
+   its parent, so that it outlives whichever of them exits
+   first. */
+struct child
+  {
+    tid_t tid;                  /* Child's thread id. */
+    int exit_status;            /* Status passed to exit(), or -1. */
+    struct semaphore exited;    /* Upped when the child exits. */
+    int ref_cnt;                /* 2 while both live, then 1, then freed. */
+    struct list_elem elem;      /* Element in the parent's children. */
+  };
+
+/* Handed by a process starting a child to the child's thread,
+   which reports back through it whether it could start. */
+struct start_info
+  {
+    const char *cmdline;        /* Program and arguments to load. */
+#ifdef VM
+    struct thread *parent;      /* Process to duplicate, for fork. */
+    const struct intr_frame *if_; /* Parent's registers, for fork. */
+#endif
+    struct child *child;        /* Child's exit status record. */
+    struct semaphore started;   /* Upped when the child is ready. */
+    bool success;               /* Did the child start? */
+  };
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static tid_t start_child (const char *name, thread_func *,
+                          struct start_info *);
+static void release_child (struct child *);
+static void program_name (const char *cmdline, char *name, size_t size);
 
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+   CMDLINE, the program's name followed by its arguments.
+   Returns the new process's thread id once the program has
+   loaded, or TID_ERROR if the thread cannot be created or the
+   program cannot be loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmdline) 
 {
-  char *fn_copy;
+  struct start_info info;
+  char name[16];
+  char *cmdline_copy;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
+  /* Make a copy of CMDLINE.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  cmdline_copy = palloc_get_page (0);
+  if (cmdline_copy == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  strlcpy (cmdline_copy, cmdline, PGSIZE);
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
+  /* Create a new thread to execute CMDLINE. */
+  info.cmdline = cmdline_copy;
+  program_name (cmdline, name, sizeof name);
+  tid = start_child (name, start_process, &info);
+  palloc_free_page (cmdline_copy); 
   return tid;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
+  struct start_info *info = info_;
   struct intr_frame if_;
-  bool success;
+
+  thread_current ()->child = info->child;
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
+  info->success = load (info->cmdline, &if_.eip, &if_.esp);
 
-  /* If load failed, quit. */
-  palloc_free_page (file_name);
-  if (!success) 
-    thread_exit ();
+  /* Let our parent go on.  INFO is gone after this. */
+  if (!info->success)
+    {
+      sema_up (&info->started);
+      thread_exit ();
+    }
+  sema_up (&info->started);
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
@@ -76,21 +122,176 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+static thread_func start_fork NO_RETURN;
+
+/* Starts a child process that is a copy of the running process,
+   whose registers on entry to the kernel are in F.  The child
+   shares the parent's memory copy-on-write: each page is mapped
+   read-only into both processes and copied by whichever of them
+   first writes to it.  The child also gets its own copy of each
+   file the parent has open, under the same handle, but not the
+   parent's memory mappings.  Returns the child's thread id, or
+   TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (const struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct start_info info;
+
+  info.parent = cur;
+  info.if_ = f;
+  return start_child (cur->name, start_fork, &info);
+}
+
+/* A thread function that copies the address space of the
+   process that forked it and starts running where that process
+   left off, with 0 as the return value of fork(). */
+static void
+start_fork (void *info_)
+{
+  struct start_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = *info->if_;
+
+  t->child = info->child;
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      lock_acquire (&filesys_lock);
+      t->exec_file = file_reopen (parent->exec_file);
+      if (t->exec_file != NULL)
+        file_deny_write (t->exec_file);
+      lock_release (&filesys_lock);
+      info->success = (t->exec_file != NULL
+                       && page_table_create ()
+                       && page_table_copy (parent->pages, parent->exec_file,
+                                           t->exec_file)
+                       && syscall_fork (parent));
+    }
+  else
+    info->success = false;
+
+  /* Let our parent go on.  INFO is gone after this. */
+  if (!info->success)
+    {
+      sema_up (&info->started);
+      thread_exit ();
+    }
+  sema_up (&info->started);
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif /* VM */
+
+/* Creates a thread named NAME that runs FUNCTION with INFO to
+   start a child of the running process, and waits for it to
+   either start or give up.  Returns the child's thread id, or
+   TID_ERROR on failure. */
+static tid_t
+start_child (const char *name, thread_func *function, struct start_info *info)
+{
+  struct thread *cur = thread_current ();
+  struct child *c;
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return TID_ERROR;
+  c->exit_status = -1;
+  sema_init (&c->exited, 0);
+  c->ref_cnt = 2;
+  info->child = c;
+  sema_init (&info->started, 0);
+
+  c->tid = thread_create (name, PRI_DEFAULT, function, info);
+  if (c->tid == TID_ERROR)
+    {
+      free (c);
+      return TID_ERROR;
+    }
+  sema_down (&info->started);
+  if (!info->success)
+    {
+      release_child (c);
+      return TID_ERROR;
+    }
+  list_push_back (&cur->children, &c->elem);
+  return c->tid;
+}
+
+/* Drops a reference to C, freeing it when the parent and child
+   are both done with it. */
+static void
+release_child (struct child *c)
+{
+  enum intr_level old_level = intr_disable ();
+  int ref_cnt = --c->ref_cnt;
+  intr_set_level (old_level);
+
+  if (ref_cnt == 0)
+    free (c);
+}
+
+/* Copies the first word of CMDLINE, the program name, into NAME,
+   truncating it to fit in SIZE bytes. */
+static void
+program_name (const char *cmdline, char *name, size_t size)
+{
+  size_t len;
+
+  cmdline += strspn (cmdline, " ");
+  len = strcspn (cmdline, " ");
+  if (len >= size)
+    len = size - 1;
+  memcpy (name, cmdline, len);
+  name[len] = '\0';
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) 
+process_wait (tid_t child_tid) 
 {
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->children); e != list_end (&cur->children);
+       e = list_next (e))
+    {
+      struct child *c = list_entry (e, struct child, elem);
+      if (c->tid == child_tid)
+        {
+          int exit_status;
+
+          sema_down (&c->exited);
+          exit_status = c->exit_status;
+          list_remove (e);
+          release_child (c);
+          return exit_status;
+        }
+    }
   return -1;
 }
 
+/* Sets the status that the running process will report to its
+   parent when it exits. */
+void
+process_set_exit_status (int status)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->child != NULL)
+    cur->child->exit_status = status;
+}
+
 /* Free the current process's resources. */
 void
 process_exit (void)
@@ -98,6 +299,25 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  /* Report our exit status to our parent, and let go of our
+     children's. */
+  if (cur->child != NULL)
+    {
+      printf ("%s: exit(%d)\n", cur->name, cur->child->exit_status);
+      sema_up (&cur->child->exited);
+      release_child (cur->child);
+      cur->child = NULL;
+    }
+  while (!list_empty (&cur->children))
+    release_child (list_entry (list_pop_front (&cur->children),
+                               struct child, elem));
+
+  /* Close open files, and write memory-mapped files back. */
+  syscall_exit ();
+#ifdef VM
+  mmap_unmap_all ();
+#endif
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -112,8 +332,22 @@ process_exit (void)
          that's been freed (and cleared). */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
+#ifdef VM
+      /* The supplemental page table unmaps and frees its
+         frames, so it must go before the page directory. */
+      page_table_destroy ();
+#endif
       pagedir_destroy (pd);
     }
+
+#ifdef VM
+  /* Pages that were never brought in referred to the
+     executable, so it stays open until now. */
+  lock_acquire (&filesys_lock);
+  file_close (cur->exec_file);
+  lock_release (&filesys_lock);
+  cur->exec_file = NULL;
+#endif
 }
 
 /* Sets up the CPU for running user code in the current
@@ -131,6 +365,70 @@ process_activate (void)
      interrupts. */
   tss_update ();
 }
+
+#ifdef VM
+/* Number of times process_exec_bench() loads its program in
+   each mode. */
+#define EXEC_BENCH_CNT 100
+
+static bool exec_bench_round (const char *file_name, bool eager);
+
+/* Measures exec latency with and without demand paging.  Loads
+   the program named in ARGV[1] into the running thread
+   EXEC_BENCH_CNT times reading every page up front, then as
+   many times lazily, each time touching its entry point and its
+   stack the way its first instructions would, and tearing it
+   down again.  Prints the time taken by each.  A program with a
+   big BSS or code it rarely runs, such as page-linear, shows the
+   difference best. */
+void
+process_exec_bench (char **argv)
+{
+  bool eager = page_eager_load;
+
+  if (exec_bench_round (argv[1], true))
+    exec_bench_round (argv[1], false);
+  page_eager_load = eager;
+}
+
+/* Runs one round of process_exec_bench() and prints its
+   results.  Returns true if successful, false if FILE_NAME
+   could not be loaded. */
+static bool
+exec_bench_round (const char *file_name, bool eager)
+{
+  int64_t start, elapsed;
+  int i;
+
+  page_eager_load = eager;
+  start = timer_ticks ();
+  for (i = 0; i < EXEC_BENCH_CNT; i++)
+    {
+      void (*eip) (void);
+      void *esp;
+      bool success = load (file_name, &eip, &esp);
+
+      if (success)
+        {
+          /* Fault in what starting the program would. */
+          *(volatile uint8_t *) eip;
+          *((volatile uint8_t *) esp - 1);
+        }
+      process_exit ();
+      if (!success)
+        {
+          printf ("exec-bench: %s: load failed\n", file_name);
+          return false;
+        }
+    }
+  elapsed = timer_elapsed (start);
+
+  printf ("exec-bench: %s: %d %s loads in %lld ticks, %lld us each\n",
+          file_name, EXEC_BENCH_CNT, eager ? "eager" : "lazy", elapsed,
+          elapsed * (1000000 / TIMER_FREQ) / EXEC_BENCH_CNT);
+  return true;
+}
+#endif /* VM */
 
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
@@ -196,6 +494,7 @@ struct Elf32_Phdr
 #define PF_R 4          /* Readable. */
 
 static bool setup_stack (void **esp);
+static bool push_args (const char *cmdline, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
@@ -206,31 +505,43 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *cmdline, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
+  char file_name[NAME_MAX + 1];
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
   off_t file_ofs;
   bool success = false;
+  bool header_ok;
   int i;
 
+  program_name (cmdline, file_name, sizeof file_name);
+
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_create ())
+    goto done;
+#endif
 
   /* Open executable file. */
+  lock_acquire (&filesys_lock);
   file = filesys_open (file_name);
+  header_ok = (file != NULL
+               && file_read (file, &ehdr, sizeof ehdr) == sizeof ehdr);
+  lock_release (&filesys_lock);
   if (file == NULL) 
     {
       printf ("load: %s: open failed\n", file_name);
       goto done; 
     }
 
-  /* Read and verify executable header. */
-  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+  /* Verify executable header. */
+  if (!header_ok
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
       || ehdr.e_machine != 3
@@ -247,12 +558,14 @@ load (const char *file_name, void (**eip) (void), void **esp)
   for (i = 0; i < ehdr.e_phnum; i++) 
     {
       struct Elf32_Phdr phdr;
-
-      if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
-      file_seek (file, file_ofs);
-
-      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
+      bool phdr_ok;
+
+      lock_acquire (&filesys_lock);
+      phdr_ok = (file_ofs >= 0 && file_ofs <= file_length (file)
+                 && (file_read_at (file, &phdr, sizeof phdr, file_ofs)
+                     == sizeof phdr));
+      lock_release (&filesys_lock);
+      if (!phdr_ok)
         goto done;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
@@ -302,7 +615,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
     }
 
   /* Set up stack. */
-  if (!setup_stack (esp))
+  if (!setup_stack (esp) || !push_args (cmdline, esp))
     goto done;
 
   /* Start address. */
@@ -312,25 +625,49 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* Pages not yet faulted in are read from FILE, so keep it open
+     until process_exit().  Other processes may share its pages,
+     so it must not change under them. */
+  lock_acquire (&filesys_lock);
+  if (success)
+    {
+      t->exec_file = file;
+      file_deny_write (file);
+    }
+  else
+    file_close (file);
+  lock_release (&filesys_lock);
+#else
+  lock_acquire (&filesys_lock);
   file_close (file);
+  lock_release (&filesys_lock);
+#endif
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
 validate_segment (const struct Elf32_Phdr *phdr, struct file *file) 
 {
+  off_t length;
+
   /* p_offset and p_vaddr must have the same page offset. */
   if ((phdr->p_offset & PGMASK) != (phdr->p_vaddr & PGMASK)) 
     return false; 
 
   /* p_offset must point within FILE. */
-  if (phdr->p_offset > (Elf32_Off) file_length (file)) 
+  lock_acquire (&filesys_lock);
+  length = file_length (file);
+  lock_release (&filesys_lock);
+  if (phdr->p_offset > (Elf32_Off) length) 
     return false;
 
   /* p_memsz must be at least as big as p_filesz. */
@@ -377,6 +714,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are entered into the supplemental page
+   table, to be read or zeroed when first touched.  They are
+   brought in right away only if the -eager-load option was
+   given.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -387,7 +729,27 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      if (page_read_bytes > 0
+          ? !page_add_file (upage, file, ofs, page_read_bytes, writable)
+          : !page_add_zero (upage, writable))
+        return false;
+      if (page_eager_load && !page_fault_in (upage))
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
+
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -395,6 +757,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
          and zero the final PAGE_ZERO_BYTES bytes. */
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      bool success;
 
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
@@ -402,7 +765,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
         return false;
 
       /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+      lock_acquire (&filesys_lock);
+      success = (file_read_at (file, kpage, page_read_bytes, ofs)
+                 == (int) page_read_bytes);
+      lock_release (&filesys_lock);
+      if (!success)
         {
           palloc_free_page (kpage);
           return false; 
@@ -419,9 +786,11 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -429,6 +798,16 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  /* The stack page is brought in right away, because the caller
+     is about to write the program's arguments to it. */
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (!page_add_zero (upage, true) || !page_fault_in (upage))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -442,8 +821,57 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
+}
+
+/* Most arguments push_args() passes to a program. */
+#define MAX_ARGS 64
+
+/* Pushes the words of CMDLINE onto the user stack at *ESP as
+   the arguments of the program's main(): the strings, then
+   argv[] with a null pointer at its end, argv, argc, and a fake
+   return address.  Updates *ESP.  Returns false if there are
+   more than MAX_ARGS words or they take more than half a
+   page. */
+static bool
+push_args (const char *cmdline, void **esp)
+{
+  char *argv[MAX_ARGS + 1];
+  size_t len = strlen (cmdline) + 1;
+  uint8_t *sp = *esp;
+  char *token, *save_ptr;
+  int argc = 0;
+
+  if (len > PGSIZE / 2)
+    return false;
+
+  /* Copy the command line to the stack and split it there. */
+  sp -= len;
+  strlcpy ((char *) sp, cmdline, len);
+  for (token = strtok_r ((char *) sp, " ", &save_ptr); token != NULL;
+       token = strtok_r (NULL, " ", &save_ptr))
+    {
+      if (argc >= MAX_ARGS)
+        return false;
+      argv[argc++] = token;
+    }
+  argv[argc] = NULL;
+
+  sp = (uint8_t *) ROUND_DOWN ((uintptr_t) sp, sizeof (char *));
+  sp -= (argc + 1) * sizeof *argv;
+  memcpy (sp, argv, (argc + 1) * sizeof *argv);
+  sp -= sizeof (char **);
+  *(char ***) sp = (char **) (sp + sizeof (char **));
+  sp -= sizeof (int);
+  *(int *) sp = argc;
+  sp -= sizeof (void *);
+  *(void **) sp = NULL;
+
+  *esp = sp;
+  return true;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -463,3 +891,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
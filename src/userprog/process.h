@@ -1,11 +1,17 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+void process_set_exit_status (int);
+#ifdef VM
+tid_t process_fork (const struct intr_frame *);
+void process_exec_bench (char **argv);
+#endif
 
 #endif /* userprog/process.h */
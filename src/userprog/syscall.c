@@ -1,20 +1,597 @@
 #include "userprog/syscall.h"
+#include <list.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "devices/shutdown.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
+
+/* An open file and the file descriptor the process knows it
+   by. */
+struct fd
+  {
+    int handle;                 /* File descriptor, 2 or above. */
+    struct file *file;          /* Open file. */
+    struct list_elem elem;      /* Element in the thread's fds. */
+  };
 
 static void syscall_handler (struct intr_frame *);
 
+static int sys_exec (const char *ufile);
+static bool sys_create (const char *ufile, unsigned initial_size);
+static bool sys_remove (const char *ufile);
+static int sys_open (const char *ufile);
+static int sys_filesize (int handle);
+static int sys_read (int handle, void *ubuffer, unsigned size);
+static int sys_write (int handle, const void *ubuffer, unsigned size);
+static void sys_seek (int handle, unsigned position);
+static unsigned sys_tell (int handle);
+static void sys_close (int handle);
+#ifdef VM
+static int sys_mmap (int handle, void *addr);
+#endif
+
+static struct fd *lookup_fd (int handle);
+static void copy_in (void *, const void *usrc, size_t size);
+static bool read_user (void *, const void *usrc, size_t size);
+static bool write_user (void *udst, const void *, size_t size);
+static char *copy_in_string (const char *us);
+static inline bool get_user (uint8_t *dst, const uint8_t *usrc);
+static inline bool put_user (uint8_t *udst, uint8_t byte);
+static void kill (void) NO_RETURN;
+
 void
-syscall_init (void) 
+syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
+/* Closes every file the running process has open.  Called when
+   the process exits. */
+void
+syscall_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+  while (!list_empty (&cur->fds))
+    {
+      struct fd *fd = list_entry (list_pop_front (&cur->fds),
+                                  struct fd, elem);
+      lock_acquire (&filesys_lock);
+      file_close (fd->file);
+      lock_release (&filesys_lock);
+      free (fd);
+    }
+}
+
+/* Gives the running process, a child being forked, its own copy
+   of each file PARENT has open, under the same handle and at the
+   same position.  PARENT must be waiting for the fork to finish.
+   Returns true if successful, false if memory or the file system
+   ran short, in which case the files copied so far are closed by
+   syscall_exit(). */
+bool
+syscall_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->fds); e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct fd *pfd = list_entry (e, struct fd, elem);
+      struct fd *fd = malloc (sizeof *fd);
+
+      if (fd == NULL)
+        return false;
+      lock_acquire (&filesys_lock);
+      fd->file = file_reopen (pfd->file);
+      if (fd->file != NULL)
+        file_seek (fd->file, file_tell (pfd->file));
+      lock_release (&filesys_lock);
+      if (fd->file == NULL)
+        {
+          free (fd);
+          return false;
+        }
+      fd->handle = pfd->handle;
+      list_push_back (&cur->fds, &fd->elem);
+    }
+  cur->next_fd = parent->next_fd;
+  return true;
+}
+
+/* System call handler.  The call number and its arguments are
+   32-bit words on the user stack, the number first. */
+static void
+syscall_handler (struct intr_frame *f)
+{
+  unsigned call_nr;
+  int args[3];
+
+  copy_in (&call_nr, f->esp, sizeof call_nr);
+  switch (call_nr)
+    {
+    case SYS_HALT:
+      shutdown_power_off ();
+
+    case SYS_EXIT:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      process_set_exit_status (args[0]);
+      thread_exit ();
+
+    case SYS_EXEC:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = sys_exec ((const char *) args[0]);
+      break;
+
+    case SYS_WAIT:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = process_wait (args[0]);
+      break;
+
+    case SYS_CREATE:
+      copy_in (args, (uint32_t *) f->esp + 1, 2 * sizeof *args);
+      f->eax = sys_create ((const char *) args[0], args[1]);
+      break;
+
+    case SYS_REMOVE:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = sys_remove ((const char *) args[0]);
+      break;
+
+    case SYS_OPEN:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = sys_open ((const char *) args[0]);
+      break;
+
+    case SYS_FILESIZE:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = sys_filesize (args[0]);
+      break;
+
+    case SYS_READ:
+      copy_in (args, (uint32_t *) f->esp + 1, 3 * sizeof *args);
+      f->eax = sys_read (args[0], (void *) args[1], args[2]);
+      break;
+
+    case SYS_WRITE:
+      copy_in (args, (uint32_t *) f->esp + 1, 3 * sizeof *args);
+      f->eax = sys_write (args[0], (const void *) args[1], args[2]);
+      break;
+
+    case SYS_SEEK:
+      copy_in (args, (uint32_t *) f->esp + 1, 2 * sizeof *args);
+      sys_seek (args[0], args[1]);
+      break;
+
+    case SYS_TELL:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      f->eax = sys_tell (args[0]);
+      break;
+
+    case SYS_CLOSE:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      sys_close (args[0]);
+      break;
+
+#ifdef VM
+    case SYS_MMAP:
+      copy_in (args, (uint32_t *) f->esp + 1, 2 * sizeof *args);
+      f->eax = sys_mmap (args[0], (void *) args[1]);
+      break;
+
+    case SYS_MUNMAP:
+      copy_in (args, (uint32_t *) f->esp + 1, sizeof *args);
+      mmap_unmap (args[0]);
+      break;
+#endif
+
+    case SYS_FORK:
+#ifdef VM
+      f->eax = process_fork (f);
+#else
+      f->eax = -1;
+#endif
+      break;
+
+    default:
+      kill ();
+    }
+}
+
+/* Exec system call. */
+static int
+sys_exec (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  tid_t tid;
+
+  if (kfile == NULL)
+    return TID_ERROR;
+  tid = process_execute (kfile);
+
+  palloc_free_page (kfile);
+  return tid;
+}
+
+/* Create system call. */
+static bool
+sys_create (const char *ufile, unsigned initial_size)
+{
+  char *kfile = copy_in_string (ufile);
+  bool success;
+
+  if (kfile == NULL)
+    return false;
+  lock_acquire (&filesys_lock);
+  success = filesys_create (kfile, initial_size);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+  return success;
+}
+
+/* Remove system call. */
+static bool
+sys_remove (const char *ufile)
+{
+  char *kfile = copy_in_string (ufile);
+  bool success;
+
+  if (kfile == NULL)
+    return false;
+  lock_acquire (&filesys_lock);
+  success = filesys_remove (kfile);
+  lock_release (&filesys_lock);
+
+  palloc_free_page (kfile);
+  return success;
+}
+
+/* Open system call. */
+static int
+sys_open (const char *ufile)
+{
+  struct thread *cur = thread_current ();
+  char *kfile = copy_in_string (ufile);
+  struct fd *fd;
+  int handle = -1;
+
+  if (kfile == NULL)
+    return -1;
+
+  fd = malloc (sizeof *fd);
+  if (fd != NULL)
+    {
+      lock_acquire (&filesys_lock);
+      fd->file = filesys_open (kfile);
+      lock_release (&filesys_lock);
+      if (fd->file != NULL)
+        {
+          fd->handle = handle = cur->next_fd++;
+          list_push_front (&cur->fds, &fd->elem);
+        }
+      else
+        free (fd);
+    }
+
+  palloc_free_page (kfile);
+  return handle;
+}
+
+/* Filesize system call. */
+static int
+sys_filesize (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+  int length;
+
+  if (fd == NULL)
+    return -1;
+  lock_acquire (&filesys_lock);
+  length = file_length (fd->file);
+  lock_release (&filesys_lock);
+  return length;
+}
+
+/* Read system call.  The data goes through a page of kernel
+   memory, so that no file system code runs while a user page
+   faults in. */
+static int
+sys_read (int handle, void *ubuffer, unsigned size)
+{
+  uint8_t *udst = ubuffer;
+  struct fd *fd;
+  uint8_t *kbuf;
+  int total = 0;
+
+  if (handle == STDIN_FILENO)
+    {
+      for (; size > 0; size--, udst++, total++)
+        {
+          uint8_t c = input_getc ();
+          if (!write_user (udst, &c, 1))
+            kill ();
+        }
+      return total;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd == NULL)
+    return -1;
+  kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
+    return -1;
+
+  while (size > 0)
+    {
+      size_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t read;
+
+      lock_acquire (&filesys_lock);
+      read = file_read (fd->file, kbuf, chunk);
+      lock_release (&filesys_lock);
+      if (read <= 0)
+        break;
+      if (!write_user (udst, kbuf, read))
+        {
+          palloc_free_page (kbuf);
+          kill ();
+        }
+      udst += read;
+      size -= read;
+      total += read;
+      if ((size_t) read < chunk)
+        break;
+    }
+
+  palloc_free_page (kbuf);
+  return total;
+}
+
+/* Write system call.  Writes to the console, file descriptor 1,
+   go out in small pieces; writes to files go through a page of
+   kernel memory, as in sys_read(). */
+static int
+sys_write (int handle, const void *ubuffer, unsigned size)
+{
+  const uint8_t *usrc = ubuffer;
+  struct fd *fd;
+  uint8_t *kbuf;
+  int total = 0;
+
+  if (handle == STDOUT_FILENO)
+    {
+      while (size > 0)
+        {
+          char buf[128];
+          size_t chunk = size < sizeof buf ? size : sizeof buf;
+
+          copy_in (buf, usrc, chunk);
+          putbuf (buf, chunk);
+          usrc += chunk;
+          size -= chunk;
+          total += chunk;
+        }
+      return total;
+    }
+
+  fd = lookup_fd (handle);
+  if (fd == NULL)
+    return -1;
+  kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
+    return -1;
+
+  while (size > 0)
+    {
+      size_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t written;
+
+      if (!read_user (kbuf, usrc, chunk))
+        {
+          palloc_free_page (kbuf);
+          kill ();
+        }
+      lock_acquire (&filesys_lock);
+      written = file_write (fd->file, kbuf, chunk);
+      lock_release (&filesys_lock);
+      if (written <= 0)
+        break;
+      usrc += written;
+      size -= written;
+      total += written;
+      if ((size_t) written < chunk)
+        break;
+    }
+
+  palloc_free_page (kbuf);
+  return total;
+}
+
+/* Seek system call. */
+static void
+sys_seek (int handle, unsigned position)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd != NULL && (off_t) position >= 0)
+    {
+      lock_acquire (&filesys_lock);
+      file_seek (fd->file, position);
+      lock_release (&filesys_lock);
+    }
+}
+
+/* Tell system call. */
+static unsigned
+sys_tell (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+  unsigned position;
+
+  if (fd == NULL)
+    return 0;
+  lock_acquire (&filesys_lock);
+  position = file_tell (fd->file);
+  lock_release (&filesys_lock);
+  return position;
+}
+
+/* Close system call. */
+static void
+sys_close (int handle)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  if (fd != NULL)
+    {
+      list_remove (&fd->elem);
+      lock_acquire (&filesys_lock);
+      file_close (fd->file);
+      lock_release (&filesys_lock);
+      free (fd);
+    }
+}
+
+#ifdef VM
+/* Mmap system call. */
+static int
+sys_mmap (int handle, void *addr)
+{
+  struct fd *fd = lookup_fd (handle);
+
+  return fd != NULL ? mmap_map (fd->file, addr) : -1;
+}
+#endif
+
+/* Returns the running process's open file with file descriptor
+   HANDLE, or a null pointer if there is none. */
+static struct fd *
+lookup_fd (int handle)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->fds); e != list_end (&cur->fds);
+       e = list_next (e))
+    {
+      struct fd *fd = list_entry (e, struct fd, elem);
+      if (fd->handle == handle)
+        return fd;
+    }
+  return NULL;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Kills the process if any byte is not readable. */
+static void
+copy_in (void *dst, const void *usrc, size_t size)
+{
+  if (!read_user (dst, usrc, size))
+    kill ();
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any byte is not
+   readable. */
+static bool
+read_user (void *dst_, const void *usrc_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  for (; size > 0; size--, dst++, usrc++)
+    if (!is_user_vaddr (usrc) || !get_user (dst, usrc))
+      return false;
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any byte is not
+   writable. */
+static bool
+write_user (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  for (; size > 0; size--, udst++, src++)
+    if (!is_user_vaddr (udst) || !put_user (udst, *src))
+      return false;
+  return true;
+}
+
+/* Copies the null-terminated string at user address US into a
+   new page and returns it, or a null pointer if no page is
+   available.  Truncates the string to PGSIZE bytes.  Kills the
+   process if the string is not readable.  The caller must free
+   the page. */
+static char *
+copy_in_string (const char *us)
+{
+  char *ks = palloc_get_page (0);
+  size_t i;
+
+  if (ks == NULL)
+    return NULL;
+  for (i = 0; i < PGSIZE; i++)
+    {
+      if (!is_user_vaddr (us + i) || !get_user ((uint8_t *) ks + i,
+                                                (const uint8_t *) us + i))
+        {
+          palloc_free_page (ks);
+          kill ();
+        }
+      if (ks[i] == '\0')
+        return ks;
+    }
+  ks[PGSIZE - 1] = '\0';
+  return ks;
+}
+
+/* Reads the byte at user address USRC into *DST.  USRC must be
+   below PHYS_BASE.  Returns true on success, false if a page
+   fault occurred, in which case page_fault() resumes at label 1
+   with %eax set to -1.  On success %eax cannot be -1, because
+   its upper bytes still hold the kernel address of label 1. */
+static inline bool
+get_user (uint8_t *dst, const uint8_t *usrc)
+{
+  int eax;
+  asm ("movl $1f, %%eax; movb %2, %%al; movb %%al, %0; 1:"
+       : "=m" (*dst), "=&a" (eax) : "m" (*usrc));
+  return eax != -1;
+}
+
+/* Writes BYTE to user address UDST.  UDST must be below
+   PHYS_BASE.  Returns true on success, false if a page fault
+   occurred, as for get_user(). */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int eax;
+  asm ("movl $1f, %%eax; movb %b2, %0; 1:"
+       : "=m" (*udst), "=&a" (eax) : "q" (byte));
+  return eax != -1;
+}
+
+/* Terminates the running process with exit status -1. */
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+kill (void)
 {
-  printf ("system call!\n");
+  process_set_exit_status (-1);
   thread_exit ();
 }
@@ -0,0 +1,405 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every page of user memory that holds a process's page is
+   listed here, with the page in it.  When the user pool runs
+   out, frame_alloc() takes a frame away from some page using
+   the clock (second-chance) algorithm: a hand sweeps the list,
+   clearing the accessed bit of each page it passes, and stops
+   at the first page whose bit was already clear, that is, one
+   not used since the hand last went by.  Each sweep gathers up
+   to SWAP_CLUSTER such pages, so that page_evict() can write
+   the ones that changed to swap in a single request, and frees
+   the frames it doesn't need right away for the allocations
+   that are bound to follow.
+
+   A frame shared by the pages of a process and its fork()ed
+   children is mapped read-only in all of them.  The first one
+   to write takes its own copy with frame_unshare(), and the
+   last one left may write to the frame as it is.  Shared frames
+   are never evicted, because evicting one would mean unmapping
+   it from every process at once; the sweep passes over them
+   until they are down to a single page.
+
+   Read-only pages of executables are shared the same way, but
+   between unrelated processes: the text table indexes each frame
+   that holds such a page by the inode sector of its file and the
+   offset of the page in it, so that a process that runs an
+   executable already running elsewhere maps the frames that
+   hold its code instead of reading its own copies.  A frame
+   leaves the table when its last page lets go of it or when it
+   is chosen for eviction.
+
+   Each page has a lock, held while it is brought in, evicted or
+   destroyed.  The sweep only takes page locks with
+   lock_try_acquire() and skips pages that are busy, so it never
+   waits for a page while holding frame_lock, and a page that is
+   still being brought in can never be chosen. */
+
+static struct list frames;              /* All frames. */
+static struct list_elem *hand;          /* Clock hand, or list end. */
+static size_t frame_cnt;                /* Number of frames. */
+static struct hash text_frames;         /* Shareable executable pages. */
+static struct lock frame_lock;          /* Protects the above. */
+static struct kmem_cache *frame_cache;  /* Allocates struct frame. */
+
+/* Statistics. */
+static long long evict_cnt;             /* Frames taken from pages. */
+
+static struct frame *evict (struct page *);
+static struct frame *clock_advance (void);
+static void frame_release (struct frame *);
+static void text_key (struct frame *, const struct page *);
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  lock_init (&frame_lock);
+  if (!hash_init (&text_frames, text_hash, text_less, NULL))
+    PANIC ("frame: out of memory");
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), 0, NULL);
+  if (frame_cache == NULL)
+    PANIC ("frame_init: out of memory");
+}
+
+/* Obtains a frame for page P, which the caller must have
+   locked, and returns it.  Takes a free page from the user pool
+   if there is one, with FLAGS as for palloc_get_page(), or
+   otherwise evicts another page.  Returns a null pointer if
+   every frame is in use by a page that cannot be evicted. */
+struct frame *
+frame_alloc (struct page *p, enum palloc_flags flags)
+{
+  struct frame *f = frame_try_alloc (p, flags);
+
+  if (f == NULL)
+    {
+      f = evict (p);
+      if (f != NULL && (flags & PAL_ZERO))
+        memset (f->kpage, 0, PGSIZE);
+    }
+  return f;
+}
+
+/* Obtains a frame for page P, which the caller must have
+   locked, from the free pages of the user pool, and returns it.
+   Returns a null pointer instead of evicting a page if there is
+   no free page. */
+struct frame *
+frame_try_alloc (struct page *p, enum palloc_flags flags)
+{
+  struct frame *f;
+  void *kpage;
+
+  ASSERT (!(flags & PAL_ASSERT));
+
+  f = kmem_cache_alloc (frame_cache);
+  if (f == NULL)
+    return NULL;
+  kpage = palloc_get_page (PAL_USER | flags);
+  if (kpage == NULL)
+    {
+      kmem_cache_free (frame_cache, f);
+      return NULL;
+    }
+
+  f->kpage = kpage;
+  list_init (&f->pages);
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt = 1;
+  f->is_text = false;
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  frame_cnt++;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Adds page P, which the caller must have locked, to the pages
+   that share frame F. */
+void
+frame_share (struct frame *f, struct page *p)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->ref_cnt > 0);
+  list_push_back (&f->pages, &p->frame_elem);
+  f->ref_cnt++;
+  lock_release (&frame_lock);
+}
+
+/* Looks in the text table for a frame that holds the same page
+   of the same executable as page P, which the caller must have
+   locked, and if there is one, adds P to the pages that share it
+   and returns it.  Otherwise, returns a null pointer. */
+struct frame *
+frame_share_text (struct page *p)
+{
+  struct frame key, *f = NULL;
+  struct hash_elem *e;
+
+  ASSERT (p->file != NULL && !p->writable);
+
+  text_key (&key, p);
+  lock_acquire (&frame_lock);
+  e = hash_find (&text_frames, &key.text_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, text_elem);
+      list_push_back (&f->pages, &p->frame_elem);
+      f->ref_cnt++;
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Enters frame F, which holds page P of an executable, read in
+   full and read-only, in the text table, so that other processes
+   running the same executable can share it.  Does nothing if
+   another frame already holds the same page. */
+void
+frame_add_text (struct frame *f, struct page *p)
+{
+  ASSERT (p->file != NULL && !p->writable);
+  ASSERT (!f->is_text);
+
+  text_key (f, p);
+  lock_acquire (&frame_lock);
+  f->is_text = hash_insert (&text_frames, &f->text_elem) == NULL;
+  lock_release (&frame_lock);
+}
+
+/* Gives page P, which the caller must have locked, a frame of
+   its own.  If P is alone in its frame, returns that frame.
+   Otherwise copies the frame into a new one, moves P there and
+   returns the new frame, leaving P's old mapping for the caller
+   to replace.  Returns a null pointer, leaving P in the shared
+   frame, if no frame can be had. */
+struct frame *
+frame_unshare (struct page *p)
+{
+  struct frame *old = p->frame;
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (old != NULL);
+
+  /* Take P out of the old frame, but keep its reference, so that
+     the frame can be neither evicted nor freed while it is
+     copied. */
+  lock_acquire (&frame_lock);
+  if (old->ref_cnt == 1)
+    {
+      lock_release (&frame_lock);
+      return old;
+    }
+  list_remove (&p->frame_elem);
+  lock_release (&frame_lock);
+
+  f = frame_alloc (p, 0);
+  if (f == NULL)
+    {
+      lock_acquire (&frame_lock);
+      list_push_back (&old->pages, &p->frame_elem);
+      lock_release (&frame_lock);
+      return NULL;
+    }
+  memcpy (f->kpage, old->kpage, PGSIZE);
+  frame_release (old);
+  return f;
+}
+
+/* Removes page P, which the caller must have locked and already
+   unmapped, from frame F.  Frees F and its page of memory once
+   no page is left in it. */
+void
+frame_free (struct frame *f, struct page *p)
+{
+  lock_acquire (&frame_lock);
+  list_remove (&p->frame_elem);
+  lock_release (&frame_lock);
+  frame_release (f);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %lld evictions\n", frame_cnt, evict_cnt);
+}
+
+/* Takes frames away from the pages in them, up to SWAP_CLUSTER
+   at a time, and returns one of them for P.  Returns a null
+   pointer if two sweeps of the clock find no page that can be
+   evicted. */
+static struct frame *
+evict (struct page *p)
+{
+  struct frame *victims[SWAP_CLUSTER];
+  struct page *pages[SWAP_CLUSTER];
+  struct frame *f = NULL;
+  size_t step = 0;
+
+  lock_acquire (&frame_lock);
+  while (f == NULL && step < 2 * frame_cnt)
+    {
+      size_t cnt = 0;
+      size_t i;
+
+      for (; step < 2 * frame_cnt && cnt < SWAP_CLUSTER; step++)
+        {
+          struct frame *v = clock_advance ();
+          struct page *q;
+
+          if (v->ref_cnt != 1 || list_empty (&v->pages))
+            continue;
+          q = list_entry (list_front (&v->pages), struct page, frame_elem);
+          if (lock_held_by_current_thread (&q->lock)
+              || !lock_try_acquire (&q->lock))
+            continue;
+          if (pagedir_is_accessed (q->pagedir, q->upage))
+            {
+              pagedir_set_accessed (q->pagedir, q->upage, false);
+              lock_release (&q->lock);
+              continue;
+            }
+          if (v->is_text)
+            {
+              /* Don't let another process find the frame while
+                 it is taken away. */
+              hash_delete (&text_frames, &v->text_elem);
+              v->is_text = false;
+            }
+          victims[cnt] = v;
+          pages[cnt++] = q;
+        }
+      if (cnt == 0)
+        break;
+
+      /* The victims' pages stay locked while they are written
+         out, so no other sweep can pick their frames. */
+      lock_release (&frame_lock);
+      page_evict (pages, cnt);
+      for (i = 0; i < cnt; i++)
+        {
+          if (pages[i]->frame != NULL)
+            {
+              /* Swap is full.  The page is still resident. */
+            }
+          else if (f == NULL)
+            {
+              f = victims[i];
+              lock_acquire (&frame_lock);
+              list_remove (&pages[i]->frame_elem);
+              list_push_back (&f->pages, &p->frame_elem);
+              lock_release (&frame_lock);
+              evict_cnt++;
+            }
+          else
+            {
+              frame_free (victims[i], pages[i]);
+              evict_cnt++;
+            }
+          lock_release (&pages[i]->lock);
+        }
+      lock_acquire (&frame_lock);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the list.  The frame table must
+   not be empty. */
+static struct frame *
+clock_advance (void)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (!list_empty (&frames));
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Drops a reference to F, and removes F from the frame table and
+   frees it and its page of memory if that was the last one. */
+static void
+frame_release (struct frame *f)
+{
+  bool last;
+
+  lock_acquire (&frame_lock);
+  ASSERT (f->ref_cnt > 0);
+  last = --f->ref_cnt == 0;
+  if (last)
+    {
+      ASSERT (list_empty (&f->pages));
+      if (f->is_text)
+        hash_delete (&text_frames, &f->text_elem);
+      if (hand == &f->elem)
+        hand = list_next (hand);
+      list_remove (&f->elem);
+      frame_cnt--;
+    }
+  lock_release (&frame_lock);
+
+  if (last)
+    {
+      palloc_free_page (f->kpage);
+      kmem_cache_free (frame_cache, f);
+    }
+}
+
+/* Sets the text table key of frame F to that of page P, a page
+   of an executable.  Two pages have the same contents if they
+   read the same bytes of the same inode. */
+static void
+text_key (struct frame *f, const struct page *p)
+{
+  f->sector = inode_get_inumber (file_get_inode (p->file));
+  f->ofs = p->ofs;
+  f->read_bytes = p->read_bytes;
+}
+
+/* Returns a hash of text frame E's key. */
+static unsigned
+text_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, text_elem);
+  return hash_int (f->sector) ^ hash_int (f->ofs) ^ hash_int (f->read_bytes);
+}
+
+/* Returns true if text frame A's key precedes text frame B's. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, text_elem);
+  const struct frame *b = hash_entry (b_, struct frame, text_elem);
+  if (a->sector != b->sector)
+    return a->sector < b->sector;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,40 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+#include "threads/palloc.h"
+
+struct page;
+
+/* A frame of user memory and the pages that occupy it.  More
+   than one page shares a frame copy-on-write after fork(). */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages held in this frame. */
+    unsigned ref_cnt;           /* Number of pages, plus copies underway. */
+    struct list_elem elem;      /* Element in the frame table. */
+
+    /* Read-only page of an executable that other processes
+       running the same executable may share. */
+    bool is_text;               /* In the text table? */
+    block_sector_t sector;      /* Inode sector of the executable. */
+    off_t ofs;                  /* Offset in the executable. */
+    uint32_t read_bytes;        /* Bytes read; the rest is zero. */
+    struct hash_elem text_elem; /* Element in the text table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, enum palloc_flags);
+struct frame *frame_try_alloc (struct page *, enum palloc_flags);
+void frame_share (struct frame *, struct page *);
+struct frame *frame_share_text (struct page *);
+void frame_add_text (struct frame *, struct page *);
+struct frame *frame_unshare (struct page *);
+void frame_free (struct frame *, struct page *);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
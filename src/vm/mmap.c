@@ -0,0 +1,137 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   mmap_map() maps a whole file at a page-aligned address by
+   adding a page to the process's page table for each page of
+   the file, through its own handle on the file's inode, so that
+   closing the file descriptor does not end the mapping.  Pages
+   are read in on first access like pages of the executable, and
+   vm/page.c writes the ones that changed back to the file.
+   Writes therefore reach the file without passing through a
+   user buffer and a read() or write() system call. */
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    int mapid;                  /* Mapping id. */
+    struct file *file;          /* File mapped. */
+    uint8_t *base;              /* Start of the mapping. */
+    size_t page_cnt;            /* Pages mapped. */
+    struct list_elem elem;      /* Element in the thread's mappings. */
+  };
+
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process's address space starting
+   at ADDR and returns a mapping id for it.  Returns -1 if ADDR
+   is null or not page-aligned, if FILE is empty, or if any page
+   the mapping would cover is already in use or not a user page. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *cur = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t page_cnt;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  lock_acquire (&filesys_lock);
+  m->file = file_reopen (file);
+  length = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&filesys_lock);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+
+  if (length == 0)
+    goto fail;
+  page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  while (m->page_cnt < page_cnt)
+    {
+      uint8_t *upage = m->base + m->page_cnt * PGSIZE;
+      off_t ofs = m->page_cnt * PGSIZE;
+      uint32_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (upage < m->base || !is_user_vaddr (upage)
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        goto fail;
+      m->page_cnt++;
+    }
+
+  m->mapid = cur->next_mapid++;
+  list_push_back (&cur->mappings, &m->elem);
+  return m->mapid;
+
+ fail:
+  unmap (m);
+  return -1;
+}
+
+/* Unmaps the current process's mapping MAPID, writing back the
+   pages that changed.  Does nothing if there is no such
+   mapping. */
+void
+mmap_unmap (int mapid)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->mappings); e != list_end (&cur->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        {
+          list_remove (&m->elem);
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Unmaps all of the current process's mappings.  Called when
+   the process exits. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *cur = thread_current ();
+
+  while (!list_empty (&cur->mappings))
+    unmap (list_entry (list_pop_front (&cur->mappings),
+                       struct mapping, elem));
+}
+
+/* Removes M's pages from the current process's address space,
+   closes its file and frees it.  M must not be in a list. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+  lock_acquire (&filesys_lock);
+  file_close (m->file);
+  lock_release (&filesys_lock);
+  free (m);
+}
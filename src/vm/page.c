@@ -0,0 +1,654 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process has a hash table of the pages of its address
+   space that are not simply present in its page directory,
+   keyed on user virtual address.  load() enters every page of
+   an executable here instead of reading it, and the page fault
+   handler brings a page in the first time it is touched: a page
+   backed by the executable is read from it and zero-padded, a
+   BSS page is just zeroed.  Startup cost is then proportional
+   to the part of the program that actually runs rather than to
+   the size of the binary.
+
+   A page's entry stays in the table for the life of the
+   process.  When memory runs short the frame table evicts pages
+   with page_evict(): a page that is unchanged since it was
+   brought in is simply dropped, to be read or zeroed again on
+   its next fault, and any other page is written to swap first
+   and read back from there.
+
+   fork() gives the child a copy of each of the parent's pages
+   with page_table_copy().  A resident page shares the parent's
+   frame, mapped read-only in both processes until one of them
+   writes to it and page_unshare() gives it a frame of its own.
+   A page in swap shares the parent's swap slot.
+
+   Read-only pages of an executable are shared the same way by
+   every process running it, through the frame table's text
+   table, so that a second instance of a program maps the frames
+   the first one read instead of reading its own.
+
+   A fault on a page read from a file also brings in the pages
+   that follow it in the same file and the same part of the
+   address space, as long as frames are free, so that a program
+   scanning its code, data or a mapped file takes one fault per
+   window of pages instead of one per page.  The window starts at
+   FAULT_AROUND_MIN pages and doubles, up to FAULT_AROUND_MAX,
+   each time the next fault lands just past the previous window,
+   the sign of a sequential scan.  Any other fault shrinks it
+   back.
+
+   A page of a memory-mapped file is read from the file like a
+   page of the executable, but changes to it are written back to
+   the file instead of to swap: when it is evicted, when it is
+   unmapped and when its process exits.  Mappings are not passed
+   on to a fork()ed child. */
+
+bool page_eager_load;
+
+/* Fault-around window bounds, in pages after the faulting one. */
+#define FAULT_AROUND_MIN 1
+#define FAULT_AROUND_MAX 16
+
+/* Statistics. */
+static long long file_fault_cnt;        /* Pages read from a file. */
+static long long zero_fault_cnt;        /* Pages zero-filled. */
+static long long write_back_cnt;        /* Pages written back to files. */
+static long long text_share_cnt;        /* Text pages shared, not read. */
+static long long around_cnt;            /* Pages faulted around. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_add (void *upage, struct file *, off_t ofs,
+                              uint32_t read_bytes, bool writable);
+static bool page_load (struct page *, bool evict);
+static void fault_around (struct page *);
+static bool page_load_swap (struct page *);
+static void page_write_back (struct page *);
+static bool is_text (const struct page *);
+
+/* Creates an empty page table for the current process.
+   Returns true if successful, false on failure. */
+bool
+page_table_create (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL))
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  return true;
+}
+
+/* Destroys the current process's page table, if it has one,
+   freeing its pages' frames and swap slots.  Must be called
+   before the page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages != NULL)
+    {
+      hash_destroy (t->pages, page_destroy);
+      free (t->pages);
+      t->pages = NULL;
+    }
+}
+
+/* Adds a copy of each page in PARENT, the page table of the
+   process that is forking, to the current process's page table,
+   which must be empty.  Pages read from file FROM are read from
+   TO in the copy.  Returns true if successful, false if memory
+   is short. */
+bool
+page_table_copy (struct hash *parent, struct file *from, struct file *to)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, parent);
+  while (hash_next (&i))
+    {
+      struct page *q = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *p;
+      bool success = true;
+
+      if (q->mmap)
+        continue;
+      p = page_add (q->upage, q->file == from ? to : q->file, q->ofs,
+                    q->read_bytes, q->writable);
+      if (p == NULL)
+        return false;
+
+      lock_acquire (&q->lock);
+      if (q->frame != NULL)
+        {
+          /* Share Q's frame, read-only in both processes from
+             now on, so that a write by either one faults. */
+          if (pagedir_set_page (p->pagedir, p->upage, q->frame->kpage, false))
+            {
+              pagedir_set_dirty (p->pagedir, p->upage,
+                                 pagedir_is_dirty (q->pagedir, q->upage));
+              pagedir_set_writable (q->pagedir, q->upage, false);
+              frame_share (q->frame, p);
+              p->frame = q->frame;
+            }
+          else
+            success = false;
+        }
+      else if (q->swap_slot != SWAP_NONE)
+        {
+          swap_share (q->swap_slot);
+          p->swap_slot = q->swap_slot;
+        }
+      lock_release (&q->lock);
+      if (!success)
+        return false;
+    }
+  return true;
+}
+
+/* Adds UPAGE to the current process's address space, to be
+   filled by reading READ_BYTES bytes from FILE starting at
+   offset OFS and zeroing the rest of the page.  FILE must stay
+   open for as long as the process can fault the page in.
+   Returns true if successful, false if UPAGE is already in the
+   address space or memory is short. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, bool writable)
+{
+  ASSERT (file != NULL);
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  return page_add (upage, file, ofs, read_bytes, writable) != NULL;
+}
+
+/* Adds UPAGE to the current process's address space, to be
+   zero-filled on first access.  Returns true if successful,
+   false if UPAGE is already in the address space or memory is
+   short. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, NULL, 0, 0, writable) != NULL;
+}
+
+/* Adds UPAGE to the current process's address space as a page
+   of a memory-mapped file, which is read from FILE like a page
+   added with page_add_file() and written back to FILE, READ_BYTES
+   bytes at offset OFS, if it changes.  Returns true if
+   successful, false if UPAGE is already in the address space or
+   memory is short. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (file != NULL);
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, file, ofs, read_bytes, true);
+  if (p == NULL)
+    return false;
+  p->mmap = true;
+  return true;
+}
+
+/* Removes UPAGE, which must be in the current process's address
+   space, freeing its frame or swap slot.  A page of a
+   memory-mapped file is written back first if it changed. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (thread_current ()->pages, &p->hash_elem);
+  page_destroy (&p->hash_elem, NULL);
+}
+
+/* Returns the current process's page that contains UADDR, or a
+   null pointer if there is none. */
+struct page *
+page_lookup (const void *uaddr)
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pages == NULL)
+    return NULL;
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Brings in the current process's page that contains UADDR.
+   Returns true if successful or if the page is already
+   resident, false if UADDR is not in the process's address
+   space or the page cannot be brought in. */
+bool
+page_fault_in (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+  bool success;
+
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    success = true;
+  else if (p->file != NULL && p->swap_slot == SWAP_NONE)
+    {
+      success = page_load (p, true);
+      if (success)
+        fault_around (p);
+    }
+  else
+    success = page_load (p, true);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Gives the current process its own copy of the page that
+   contains UADDR, after a write to it faulted because the page
+   was shared copy-on-write.  Returns true if successful, false
+   if UADDR is not in a writable page of the process's address
+   space or no frame can be had for the copy. */
+bool
+page_unshare (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+  bool success = true;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->frame == NULL)
+    {
+      /* Evicted since the fault, and mapped writable when it is
+         brought back in. */
+      success = page_load (p, true);
+    }
+  else
+    {
+      struct frame *f = frame_unshare (p);
+
+      if (f == NULL)
+        success = false;
+      else if (f == p->frame)
+        pagedir_set_writable (p->pagedir, p->upage, true);
+      else
+        {
+          /* The page table is still there, so this can't fail. */
+          pagedir_clear_page (p->pagedir, p->upage);
+          p->frame = f;
+          if (!pagedir_set_page (p->pagedir, p->upage, f->kpage, true))
+            NOT_REACHED ();
+          pagedir_set_dirty (p->pagedir, p->upage, true);
+        }
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Evicts the CNT pages in PAGES, which must be resident and
+   locked by the caller, and leaves their frames in the frame
+   table for the caller to reuse or free.  The pages that have
+   changed since they were brought in are written to swap
+   together, in consecutive slots if there is a long enough run
+   of them.  Each evicted page's frame is set to null.  A page
+   that must go to swap when swap is full stays resident. */
+void
+page_evict (struct page *pages[], size_t cnt)
+{
+  struct page *dirty[SWAP_CLUSTER];
+  size_t dirty_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  /* Unmap the pages first, so that their owners can't change
+     them while they are written out.  Clearing a mapping keeps
+     the dirty bit. */
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = pages[i];
+
+      ASSERT (lock_held_by_current_thread (&p->lock));
+      ASSERT (p->frame != NULL);
+
+      pagedir_clear_page (p->pagedir, p->upage);
+      if (!pagedir_is_dirty (p->pagedir, p->upage))
+        p->frame = NULL;
+      else if (p->mmap)
+        {
+          page_write_back (p);
+          p->frame = NULL;
+        }
+      else
+        dirty[dirty_cnt++] = p;
+    }
+
+  if (dirty_cnt > 0 && swap_out (dirty, dirty_cnt))
+    {
+      for (i = 0; i < dirty_cnt; i++)
+        dirty[i]->frame = NULL;
+      return;
+    }
+
+  /* No run of free slots is long enough.  Write the pages one
+     at a time instead. */
+  for (i = 0; i < dirty_cnt; i++)
+    {
+      struct page *p = dirty[i];
+
+      if (swap_out (&p, 1))
+        p->frame = NULL;
+      else
+        {
+          /* The page table is still there, so this can't fail. */
+          if (!pagedir_set_page (p->pagedir, p->upage, p->frame->kpage,
+                                 p->writable))
+            NOT_REACHED ();
+          pagedir_set_dirty (p->pagedir, p->upage, true);
+        }
+    }
+}
+
+/* Prints demand paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages read from files, %lld pages zero-filled, "
+          "%lld pages written back to files, %lld text pages shared, "
+          "%lld pages faulted around\n",
+          file_fault_cnt, zero_fault_cnt, write_back_cnt, text_share_cnt,
+          around_cnt);
+}
+
+/* Adds a page to the current process's page table and returns
+   it, or a null pointer on failure. */
+static struct page *
+page_add (void *upage, struct file *file, off_t ofs,
+          uint32_t read_bytes, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (t->pages != NULL);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->pagedir = t->pagedir;
+  p->writable = writable;
+  lock_init (&p->lock);
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->mmap = false;
+  if (hash_insert (t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Obtains a frame for page P, which must be locked and not
+   resident, fills it from swap, from P's file or with zeros,
+   and maps it.  Takes a frame from another page if there is no
+   free one and EVICT is true.  Returns true if successful, false
+   if no frame can be had or the file can't be read. */
+static bool
+page_load (struct page *p, bool evict)
+{
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame == NULL);
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      ASSERT (evict);
+      return page_load_swap (p);
+    }
+
+  /* Use another process's copy of a read-only executable page if
+     there is one. */
+  if (is_text (p) && (p->frame = frame_share_text (p)) != NULL)
+    {
+      text_share_cnt++;
+      goto map;
+    }
+
+  if (evict)
+    p->frame = frame_alloc (p, p->file == NULL ? PAL_ZERO : 0);
+  else
+    p->frame = frame_try_alloc (p, p->file == NULL ? PAL_ZERO : 0);
+  if (p->frame == NULL)
+    return false;
+
+  if (p->file != NULL)
+    {
+      uint8_t *kpage = p->frame->kpage;
+      off_t read;
+
+      lock_acquire (&filesys_lock);
+      read = file_read_at (p->file, kpage, p->read_bytes, p->ofs);
+      lock_release (&filesys_lock);
+      if (read != (off_t) p->read_bytes)
+        goto fail;
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      if (is_text (p))
+        frame_add_text (p->frame, p);
+      file_fault_cnt++;
+    }
+  else
+    zero_fault_cnt++;
+
+ map:
+  if (!pagedir_set_page (p->pagedir, p->upage, p->frame->kpage, p->writable))
+    goto fail;
+  return true;
+
+ fail:
+  frame_free (p->frame, p);
+  p->frame = NULL;
+  return false;
+}
+
+/* Brings in pages that follow page P, which was just read from
+   its file and is still locked, without evicting anything.  The
+   window of pages grows while the current process's faults are
+   sequential.  Stops at the first page that is not read from
+   the next part of P's file, or that can't be brought in right
+   away. */
+static void
+fault_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = p->upage;
+  size_t i;
+
+  if (upage == t->fault_next && t->fault_window != 0)
+    {
+      t->fault_window *= 2;
+      if (t->fault_window > FAULT_AROUND_MAX)
+        t->fault_window = FAULT_AROUND_MAX;
+    }
+  else
+    t->fault_window = FAULT_AROUND_MIN;
+
+  for (i = 1; i <= t->fault_window; i++)
+    {
+      struct page *q = page_lookup (upage + i * PGSIZE);
+      bool success = true;
+
+      if (q == NULL || q->file != p->file
+          || q->ofs != p->ofs + (off_t) (i * PGSIZE)
+          || q->writable != p->writable || q->mmap != p->mmap
+          || !lock_try_acquire (&q->lock))
+        break;
+      if (q->frame == NULL && q->swap_slot == SWAP_NONE)
+        {
+          success = page_load (q, false);
+          if (success)
+            around_cnt++;
+        }
+      lock_release (&q->lock);
+      if (!success)
+        break;
+    }
+  t->fault_next = upage + i * PGSIZE;
+}
+
+/* Brings in page P, which must be locked and in swap.  Pages of
+   the same process in the swap slots that follow P's are read
+   ahead in the same request, as long as they are not busy and
+   there are free frames for them, on the bet that pages swapped
+   out together are used together.  Returns true if P was
+   brought in, false on failure. */
+static bool
+page_load_swap (struct page *p)
+{
+  struct page *pages[SWAP_CLUSTER];
+  size_t cnt, i;
+
+  p->frame = frame_alloc (p, 0);
+  if (p->frame == NULL)
+    return false;
+
+  pages[0] = p;
+  for (cnt = 1; cnt < SWAP_CLUSTER; cnt++)
+    {
+      struct page *q = swap_owner (p->swap_slot + cnt, p->pagedir);
+
+      if (q == NULL || lock_held_by_current_thread (&q->lock)
+          || !lock_try_acquire (&q->lock))
+        break;
+      if (q->swap_slot != p->swap_slot + cnt
+          || (q->frame = frame_try_alloc (q, 0)) == NULL)
+        {
+          lock_release (&q->lock);
+          break;
+        }
+      pages[cnt] = q;
+    }
+  swap_in (pages, cnt);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = pages[i];
+
+      if (pagedir_set_page (q->pagedir, q->upage, q->frame->kpage,
+                            q->writable))
+        {
+          /* The swap slot goes away, so the page must be written
+             out again if it is evicted, changed or not. */
+          pagedir_set_dirty (q->pagedir, q->upage, true);
+          swap_free (q->swap_slot);
+          q->swap_slot = SWAP_NONE;
+        }
+      else
+        {
+          frame_free (q->frame, q);
+          q->frame = NULL;
+        }
+      if (q != p)
+        lock_release (&q->lock);
+    }
+  return p->frame != NULL;
+}
+
+/* Writes the contents of page P, which must be locked, resident
+   and part of a memory-mapped file, back to its file. */
+static void
+page_write_back (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->mmap && p->frame != NULL);
+
+  lock_acquire (&filesys_lock);
+  file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  lock_release (&filesys_lock);
+  write_back_cnt++;
+}
+
+/* Returns true if P is a read-only page of an executable, which
+   every process running the executable may share. */
+static bool
+is_text (const struct page *p)
+{
+  return p->file != NULL && !p->writable;
+}
+
+/* Returns a hash of page E's address. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees page E, along with its frame or swap slot.  Waits for
+   the page to be written out first if the frame table is
+   evicting it. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (p->pagedir, p->upage);
+      if (p->mmap && pagedir_is_dirty (p->pagedir, p->upage))
+        page_write_back (p);
+      frame_free (p->frame, p);
+    }
+  else if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  free (p);
+}
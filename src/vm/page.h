@@ -0,0 +1,51 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+
+/* A page of a process's address space that is not necessarily
+   resident, and where to get its contents when it is needed. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    uint32_t *pagedir;          /* Page directory that maps UPAGE. */
+    bool writable;              /* Mapped writable? */
+    struct lock lock;           /* Held while paging in or out. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in FRAME's pages. */
+    size_t swap_slot;           /* Swap slot holding it, or SWAP_NONE. */
+    struct file *file;          /* File to read from, or null. */
+    off_t ofs;                  /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read; the rest is zeroed. */
+    bool mmap;                  /* Write changes back to FILE? */
+    struct hash_elem hash_elem; /* Element in the process's page table. */
+  };
+
+/* -eager-load: Read every page of an executable at exec time? */
+extern bool page_eager_load;
+
+bool page_table_create (void);
+void page_table_destroy (void);
+bool page_table_copy (struct hash *, struct file *from, struct file *to);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes);
+void page_remove (void *upage);
+struct page *page_lookup (const void *uaddr);
+bool page_fault_in (const void *uaddr);
+bool page_unshare (const void *uaddr);
+void page_evict (struct page *[], size_t cnt);
+
+void page_print_stats (void);
+
+#endif /* vm/page.h */
@@ -0,0 +1,235 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Swap space.
+
+   The BLOCK_SWAP device is divided into page-sized slots, each
+   PAGE_SECTORS consecutive sectors long.  A bitmap records the
+   slots in use.  A page written out by swap_out() stays in its
+   slot until swap_in() reads it back and the slot is freed, or
+   until swap_free() discards it.  Without a swap device every
+   slot is "full", so only pages that can be recreated from
+   their files can be evicted.
+
+   Writing a page a sector at a time costs a disk command and a
+   wait per sector, so swap_out() takes up to SWAP_CLUSTER pages
+   at once, gives them consecutive slots, and writes them all
+   with a single block_write_multiple().  Each slot remembers the
+   page in it and that page's page directory, so that when a
+   process faults one of its pages back in, the page code can
+   find the process's pages in the slots that follow and have
+   swap_in() read them in the same request.
+
+   A page in swap when its process forks is shared by the child
+   through swap_share(), which counts the extra reference; the
+   slot is freed when the last of the pages lets go of it.  A
+   shared slot has no owner, so it is never read ahead. */
+
+/* Sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Owner of a swap slot. */
+struct slot
+  {
+    struct page *page;          /* Page in the slot, or null if shared. */
+    const uint32_t *pagedir;    /* PAGE's page directory. */
+    unsigned ref_cnt;           /* Number of pages in the slot. */
+  };
+
+static struct block *swap_block;        /* Swap device, or null. */
+static struct bitmap *swap_map;         /* Slots in use. */
+static struct slot *slots;              /* Owner of each slot. */
+static struct lock swap_lock;           /* Protects swap_map, slots. */
+
+/* Buffer for multi-page transfers, SWAP_CLUSTER pages long, and
+   a lock that protects it. */
+static uint8_t *cluster_buf;
+static struct lock cluster_lock;
+
+/* Statistics. */
+static long long out_cnt, out_req_cnt;  /* Pages and requests written. */
+static long long in_cnt, in_req_cnt;    /* Pages and requests read. */
+static int64_t io_ticks;                /* Timer ticks spent on I/O. */
+
+/* Initializes swap space on the BLOCK_SWAP device, if there is
+   one. */
+void
+swap_init (void)
+{
+  size_t slot_cnt;
+
+  lock_init (&swap_lock);
+  lock_init (&cluster_lock);
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block == NULL)
+    return;
+
+  slot_cnt = block_size (swap_block) / PAGE_SECTORS;
+  swap_map = bitmap_create (slot_cnt);
+  slots = calloc (slot_cnt, sizeof *slots);
+  cluster_buf = palloc_get_multiple (0, SWAP_CLUSTER);
+  if (swap_map == NULL || slots == NULL || cluster_buf == NULL)
+    PANIC ("swap: out of memory--swap device is too large");
+}
+
+/* Writes the CNT pages in PAGES, which must be resident, locked
+   and unmapped, to CNT consecutive swap slots with a single
+   request, and sets each page's swap slot.  Returns true if
+   successful, false if swap has no run of CNT free slots. */
+bool
+swap_out (struct page *pages[], size_t cnt)
+{
+  size_t slot, i;
+  int64_t start;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+  if (swap_map == NULL)
+    return false;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+  if (slot != BITMAP_ERROR)
+    for (i = 0; i < cnt; i++)
+      {
+        slots[slot + i].page = pages[i];
+        slots[slot + i].pagedir = pages[i]->pagedir;
+        slots[slot + i].ref_cnt = 1;
+      }
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return false;
+
+  start = timer_ticks ();
+  if (cnt == 1)
+    block_write_multiple (swap_block, slot * PAGE_SECTORS, PAGE_SECTORS,
+                          pages[0]->frame->kpage);
+  else
+    {
+      lock_acquire (&cluster_lock);
+      for (i = 0; i < cnt; i++)
+        memcpy (cluster_buf + i * PGSIZE, pages[i]->frame->kpage, PGSIZE);
+      block_write_multiple (swap_block, slot * PAGE_SECTORS,
+                            cnt * PAGE_SECTORS, cluster_buf);
+      lock_release (&cluster_lock);
+    }
+  io_ticks += timer_elapsed (start);
+
+  for (i = 0; i < cnt; i++)
+    pages[i]->swap_slot = slot + i;
+  out_cnt += cnt;
+  out_req_cnt++;
+  return true;
+}
+
+/* Reads the CNT pages in PAGES, which must be locked and have
+   frames, from their swap slots with a single request.  The
+   pages must be in consecutive slots, in order.  The slots stay
+   allocated until the caller frees them with swap_free(). */
+void
+swap_in (struct page *pages[], size_t cnt)
+{
+  size_t slot = pages[0]->swap_slot;
+  size_t i;
+  int64_t start;
+
+  ASSERT (swap_map != NULL);
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+  for (i = 0; i < cnt; i++)
+    ASSERT (pages[i]->swap_slot == slot + i);
+
+  start = timer_ticks ();
+  if (cnt == 1)
+    block_read_multiple (swap_block, slot * PAGE_SECTORS, PAGE_SECTORS,
+                         pages[0]->frame->kpage);
+  else
+    {
+      lock_acquire (&cluster_lock);
+      block_read_multiple (swap_block, slot * PAGE_SECTORS,
+                           cnt * PAGE_SECTORS, cluster_buf);
+      for (i = 0; i < cnt; i++)
+        memcpy (pages[i]->frame->kpage, cluster_buf + i * PGSIZE, PGSIZE);
+      lock_release (&cluster_lock);
+    }
+  io_ticks += timer_elapsed (start);
+
+  in_cnt += cnt;
+  in_req_cnt++;
+}
+
+/* Drops a page's reference to SLOT, and frees SLOT if no page
+   is left in it. */
+void
+swap_free (size_t slot)
+{
+  ASSERT (swap_map != NULL);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  ASSERT (slots[slot].ref_cnt > 0);
+  if (--slots[slot].ref_cnt == 0)
+    {
+      bitmap_reset (swap_map, slot);
+      slots[slot].page = NULL;
+      slots[slot].pagedir = NULL;
+    }
+  lock_release (&swap_lock);
+}
+
+/* Adds a reference to SLOT, which is in use, for another page
+   that holds the same data.  The slot no longer has an owner for
+   swap_owner() to report. */
+void
+swap_share (size_t slot)
+{
+  ASSERT (swap_map != NULL);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  slots[slot].ref_cnt++;
+  slots[slot].page = NULL;
+  slots[slot].pagedir = NULL;
+  lock_release (&swap_lock);
+}
+
+/* Returns the page in SLOT if SLOT is in use by a page mapped
+   by PAGEDIR, otherwise a null pointer.  Only the process that
+   owns PAGEDIR may use the page returned, since only it can
+   free the page. */
+struct page *
+swap_owner (size_t slot, const uint32_t *pagedir)
+{
+  struct page *p = NULL;
+
+  if (swap_map == NULL || slot >= bitmap_size (swap_map))
+    return NULL;
+
+  lock_acquire (&swap_lock);
+  if (bitmap_test (swap_map, slot) && slots[slot].pagedir == pagedir)
+    p = slots[slot].page;
+  lock_release (&swap_lock);
+  return p;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld pages written in %lld requests, "
+          "%lld pages read in %lld requests",
+          out_cnt, out_req_cnt, in_cnt, in_req_cnt);
+  if (io_ticks > 0)
+    printf (", %lld pages/s", (out_cnt + in_cnt) * TIMER_FREQ / io_ticks);
+  printf ("\n");
+}
@@ -0,0 +1,24 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct page;
+
+/* A swap slot that holds nothing. */
+#define SWAP_NONE SIZE_MAX
+
+/* Most pages written or read with a single request. */
+#define SWAP_CLUSTER 8
+
+void swap_init (void);
+bool swap_out (struct page *pages[], size_t cnt);
+void swap_in (struct page *pages[], size_t cnt);
+void swap_free (size_t slot);
+void swap_share (size_t slot);
+struct page *swap_owner (size_t slot, const uint32_t *pagedir);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */